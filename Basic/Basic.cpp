@@ -4,29 +4,155 @@
  * This file is the starter project for the BASIC interpreter.
  */
 
-#include <cctype>
 #include <iostream>
+#include <memory>
 #include <string>
-#include "exp.hpp"
-#include "parser.hpp"
+#include "interpreter.hpp"
 #include "program.hpp"
+#include "server.hpp"
+#include "batch.hpp"
+#include "lanes.hpp"
+#include "varstore.hpp"
+#include "journal.hpp"
 #include "Utils/error.hpp"
-#include "Utils/tokenScanner.hpp"
 #include "Utils/strlib.hpp"
 
-
-/* Function prototypes */
-
-void processLine(std::string line, Program &program, EvalState &state);
-void tokenToString(TokenScanner&, std::string&);
-
 /* Main program */
 
-int main() {
+int main(int argc, char *argv[]) {
     //给出变量记录state（string->int map)
     EvalState state;
     //给出程序记录program：int->string map
     Program program;
+    //--precompute[=N]：对不含INPUT的程序预先求值，N为语句数上限。
+    //--server PATH [--workers N] [--quantum N]：在Unix套接字PATH上为多个用户服务，
+    //  给出quantum时各RUN轮流执行，每次至多N条语句。
+    //--batch DIR [--merged] [--workers N]：运行目录中所有.bas程序。
+    //--lanes FILE [--width 8|16]：对标准输入的每条记录运行FILE中的程序；有限制时逐条运行。
+    //--cache DIR：--batch与--lanes载入程序时使用DIR中的程序映像。
+    //--max-statements N, --max-time MS, --max-variables N, --max-output BYTES：每次RUN的限制。
+    //--vars FILE [--autosave]：SAVEVARS与LOADVARS使用的变量文件；给出autosave时
+    //  启动时从中恢复变量，之后每次修改变量都同步写入。
+    //--journal FILE：把对程序的每次修改记入FILE，启动时从中恢复程序。
+    //--share-expressions：各行相同的表达式只存一份。
+    long precompute = 0;
+    std::string server;
+    std::string batch;
+    bool merged = false;
+    std::string lanes;
+    int width = 8;
+    int workers = 0;
+    long quantum = 0;
+    RunLimits limits;
+    std::string cache;
+    std::string vars;
+    bool autosave = false;
+    std::string journal;
+    bool sharing = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--precompute") {
+            precompute = 1000000;
+        }
+        else if (startsWith(option, "--precompute=")) {
+            precompute = stringToInteger(option.substr(13));
+        }
+        else if (option == "--server" && i + 1 < argc) {
+            server = argv[++i];
+        }
+        else if (option == "--batch" && i + 1 < argc) {
+            batch = argv[++i];
+        }
+        else if (option == "--merged") {
+            merged = true;
+        }
+        else if (option == "--lanes" && i + 1 < argc) {
+            lanes = argv[++i];
+        }
+        else if (option == "--width" && i + 1 < argc && (std::string(argv[i + 1]) == "8" || std::string(argv[i + 1]) == "16")) {
+            width = stringToInteger(argv[++i]);
+        }
+        else if (option == "--workers" && i + 1 < argc) {
+            workers = stringToInteger(argv[++i]);
+        }
+        else if (option == "--quantum" && i + 1 < argc) {
+            quantum = stringToInteger(argv[++i]);
+        }
+        else if (option == "--cache" && i + 1 < argc) {
+            cache = argv[++i];
+        }
+        else if (option == "--vars" && i + 1 < argc) {
+            vars = argv[++i];
+        }
+        else if (option == "--autosave") {
+            autosave = true;
+        }
+        else if (option == "--journal" && i + 1 < argc) {
+            journal = argv[++i];
+        }
+        else if (option == "--share-expressions") {
+            sharing = true;
+        }
+        else if (option == "--max-statements" && i + 1 < argc) {
+            limits.statements = stringToInteger(argv[++i]);
+        }
+        else if (option == "--max-time" && i + 1 < argc) {
+            limits.milliseconds = stringToInteger(argv[++i]);
+        }
+        else if (option == "--max-variables" && i + 1 < argc) {
+            limits.variables = stringToInteger(argv[++i]);
+        }
+        else if (option == "--max-output" && i + 1 < argc) {
+            limits.output = stringToInteger(argv[++i]);
+        }
+        else {
+            std::cerr << "Usage: code [--precompute[=N]] [--server PATH [--quantum N] | --batch DIR [--merged]] [--workers N]\n"
+                      << "       code --lanes FILE [--width 8|16] < RECORDS\n"
+                      << "Batch and lanes: [--cache DIR]\n"
+                      << "Limits: [--max-statements N] [--max-time MS] [--max-variables N] [--max-output BYTES]\n"
+                      << "        (with --lanes, limits run the records one at a time)\n"
+                      << "Variables: [--vars FILE [--autosave]]\n"
+                      << "Program: [--journal FILE] [--share-expressions]" << std::endl;
+            return 1;
+        }
+    }
+    if (!server.empty()) {
+        return runServer(server, workers, precompute, quantum, limits);
+    }
+    if (!batch.empty()) {
+        return runBatch(batch, workers, merged, precompute, limits, cache);
+    }
+    if (!lanes.empty()) {
+        return runLanes(lanes, width, cache, limits, std::cin, std::cout);
+    }
+    program.setPrecomputeBudget(precompute);
+    program.setRunLimits(limits);
+    program.setExpressionSharing(sharing);
+    std::unique_ptr<VariableStore> store;
+    if (!vars.empty()) {
+        store.reset(new VariableStore(vars));
+        try {
+            if (autosave) {
+                store->attach(state);
+            }
+            else {
+                state.setStore(store.get(), false);
+            }
+        } catch (ErrorException &ex) {
+            std::cerr << vars << ": " << ex.getMessage() << std::endl;
+            return 1;
+        }
+    }
+    std::unique_ptr<EditJournal> edits;
+    if (!journal.empty()) {
+        edits.reset(new EditJournal(journal));
+        try {
+            edits->attach(program);
+        } catch (ErrorException &ex) {
+            std::cerr << journal << ": " << ex.getMessage() << std::endl;
+            return 1;
+        }
+    }
     //cout << "Stub implementation of BASIC" << endl;
     while (true) {
         try {
@@ -35,118 +161,11 @@ int main() {
             if (input.empty())
                 continue;
             processLine(input, program, state);
+            if (state.isQuitRequested())
+                break;
         } catch (ErrorException &ex) {
             std::cout << ex.getMessage() << std::endl;
         }
     }
     return 0;
 }
-
-/*
- * Function: processLine
- * Usage: processLine(line, program, state);
- * -----------------------------------------
- * Processes a single line entered by the user.  In this version of
- * implementation, the program reads a line, parses it as an expression,
- * and then prints the result.  In your implementation, you will
- * need to replace this method with one that can respond correctly
- * when the user enters a program line (which begins with a number)
- * or one of the BASIC commands, such as LIST or RUN.
- */
-
-void processLine(std::string line, Program &program, EvalState &state) {
-    TokenScanner scanner;
-    scanner.ignoreWhitespace();
-    scanner.scanNumbers();
-    scanner.setInput(line);
-    std::string next = scanner.nextToken();
-    TokenType type = scanner.getTokenType(next);
-    switch (type) {
-    case NUMBER: {
-        int number = stringToInteger(next);
-        if(!scanner.hasMoreTokens()){
-            program.removeSourceLine(number);
-            return;
-        }
-        next = scanner.nextToken();
-        scanner.saveToken(next);
-        std::string say;
-        tokenToString(scanner, say);
-        scanner.setInput(say);
-        if (next == "REM") {
-            Sequential* statement_1=new Sequential(scanner);
-            program.addSourceLine(number, say, *statement_1);
-        }
-        else if (next == "LET") {
-            Sequential* statement_1=new Sequential(scanner);
-            program.addSourceLine(number, say, *statement_1);
-        }
-        else if (next == "PRINT") {
-            Sequential* statement_1=new Sequential(scanner);
-            program.addSourceLine(number, say, *statement_1);
-        }
-        else if (next == "INPUT") {
-            Sequential* statement_1=new Sequential(scanner);
-            program.addSourceLine(number, say, *statement_1);
-        }
-        else if (next == "GOTO") {
-            GOTO* statement_1=new GOTO(scanner);
-            program.addSourceLine(number, say, *statement_1);
-        }
-        else if (next == "END") {
-            END* statement_1=new END(scanner);
-            program.addSourceLine(number, say, *statement_1);
-        }
-        else if (next == "IF") {
-            IF* statement_1=new IF(scanner);
-            program.addSourceLine(number, say, *statement_1);
-        }
-        else{
-            error("SYNTAXERROR");
-        }
-        break;
-    }
-    case WORD: {
-        if(next=="QUIT"){
-            exit(0);
-        }
-        else if(next=="HELP"){
-            std::cout<<"???";
-        }
-        else if(next=="LET"){
-            scanner.saveToken(next);
-            Sequential statement_1(scanner);
-            statement_1.execute(state,program);
-        }
-        else if(next=="PRINT"){
-            scanner.saveToken(next);
-            Sequential statement_1(scanner);
-            statement_1.execute(state,program);
-        }
-        else if(next=="INPUT"){
-            scanner.saveToken(next);
-            Sequential statement_1(scanner);
-            statement_1.execute(state,program);
-        }
-        else if(next=="RUN"||next=="LIST"||next=="CLEAR"){
-            scanner.saveToken(next);
-            Command statement_1(scanner);
-            statement_1.execute(state,program);
-        }
-        else{
-            error("SYNTAXERROR");
-        }
-        break;
-    }
-    default: {
-        error("SYNTAXERROR");
-    }
-    }
-}
-
-void tokenToString(TokenScanner& copies, std::string& object) {
-    while (copies.hasMoreTokens()) {
-        object += copies.nextToken();
-        object += ' ';
-    }
-}
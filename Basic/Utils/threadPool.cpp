@@ -0,0 +1,101 @@
+#include "threadPool.hpp"
+
+/*
+ * The pool and the index of the worker running on the current thread,
+ * so that submit can tell a worker of this pool from any other thread.
+ */
+
+static thread_local const ThreadPool *currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+ThreadPool::ThreadPool(int workers) : next(0), pending(0) {
+    stopping = false;
+    if (workers <= 0) {
+        workers = (int) std::thread::hardware_concurrency();
+        if (workers <= 0) workers = 1;
+    }
+    for (int i = 0; i < workers; ++i) {
+        queues.emplace_back(new Queue);
+    }
+    for (int i = 0; i < workers; ++i) {
+        threads.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(idle);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    queue(std::move(task), false);
+}
+
+void ThreadPool::defer(std::function<void()> task) {
+    queue(std::move(task), true);
+}
+
+void ThreadPool::queue(std::function<void()> task, bool oldest) {
+    int index = currentPool == this ? currentWorker : (int) (next++ % queues.size());
+    {
+        std::lock_guard<std::mutex> guard(queues[index]->lock);
+        if (oldest) queues[index]->tasks.push_front(std::move(task));
+        else queues[index]->tasks.push_back(std::move(task));
+    }
+    pending++;
+    {
+        std::lock_guard<std::mutex> guard(idle);
+    }
+    ready.notify_one();
+}
+
+int ThreadPool::size() const {
+    return (int) threads.size();
+}
+
+//----------------------------------------------------------------------------------------
+
+void ThreadPool::work(int index) {
+    currentPool = this;
+    currentWorker = index;
+    while (true) {
+        std::function<void()> task;
+        if (take(index, task)) {
+            pending--;
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(idle);
+        ready.wait(guard, [this] { return stopping || pending > 0; });
+        if (stopping && pending == 0) return;
+    }
+}
+
+bool ThreadPool::take(int index, std::function<void()> &task) {
+    {
+        Queue &own = *queues[index];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    int count = (int) queues.size();
+    for (int i = 1; i < count; ++i) {
+        Queue &victim = *queues[(index + i) % count];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,90 @@
+#ifndef CODE_THREADPOOL_HPP
+#define CODE_THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Class: ThreadPool
+ * -----------------
+ * A fixed number of worker threads that run the tasks submitted to the
+ * pool.  Every worker has its own queue.  Tasks submitted from outside
+ * the pool are dealt to the queues in turn, and a task submitted by a
+ * worker goes to the queue of that worker.  A worker takes the newest
+ * task of its own queue and, when that is empty, steals the oldest task
+ * of another queue, so the load spreads even when the tasks differ
+ * greatly in length.  Destroying the pool waits for the tasks already
+ * submitted to finish.
+ */
+
+class ThreadPool {
+public:
+
+/*
+ * Constructor: ThreadPool
+ * Usage: ThreadPool pool(workers);
+ * --------------------------------
+ * Starts the given number of worker threads, or one per core if the
+ * number is not positive.
+ */
+
+    explicit ThreadPool(int workers = 0);
+
+    ~ThreadPool();
+
+/*
+ * Method: submit
+ * Usage: pool.submit(task);
+ * -------------------------
+ * Queues a task to be run by one of the workers.
+ */
+
+    void submit(std::function<void()> task);
+
+/*
+ * Method: defer
+ * Usage: pool.defer(task);
+ * ------------------------
+ * Queues a task like submit, but at the oldest end of the queue, so a
+ * worker that defers a task takes every task already in its own queue
+ * first, while the other workers steal it first.  A task that defers
+ * its own continuation lets the other tasks run between its turns.
+ */
+
+    void defer(std::function<void()> task);
+
+/*
+ * Method: size
+ * Usage: int workers = pool.size();
+ * ---------------------------------
+ * Returns the number of worker threads.
+ */
+
+    int size() const;
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<unsigned> next;
+    std::atomic<int> pending;
+    std::mutex idle;
+    std::condition_variable ready;
+    bool stopping;
+
+    void queue(std::function<void()> task, bool oldest);
+    void work(int index);
+    bool take(int index, std::function<void()> &task);
+};
+
+#endif //CODE_THREADPOOL_HPP
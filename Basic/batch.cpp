@@ -0,0 +1,163 @@
+/*
+ * File: batch.cpp
+ * ---------------
+ * Implements the batch.h interface.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include "batch.hpp"
+#include "imagecache.hpp"
+#include "interpreter.hpp"
+#include "Utils/error.hpp"
+#include "Utils/strlib.hpp"
+#include "Utils/threadPool.hpp"
+
+/*
+ * Implementation notes: runBatch
+ * ------------------------------
+ * Each program is one task of the pool.  Its output is collected in
+ * memory and either written to its own file by the worker or handed
+ * back to the main thread, which writes the results to standard output
+ * as soon as every earlier program has finished, so the merged stream
+ * keeps its order without waiting for the whole batch.
+ *
+ * A file that only holds numbered lines, all of them valid, leaves a
+ * program and no output, so that program is what the cache keeps for
+ * it.
+ */
+
+struct BatchJob {
+    std::string program;
+    std::string input;
+    std::string output;
+    std::string text;
+    bool done = false;
+    bool readable = true;
+};
+
+static void runJob(BatchJob &job, long precompute, const RunLimits &limits, const std::string &cache) {
+    std::ifstream file(job.program);
+    if (!file) {
+        job.readable = false;
+        return;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    std::string text = contents.str();
+    std::istringstream source(text);
+    std::ifstream input(job.input);
+    std::istringstream empty;
+    std::ostringstream out;
+    Program program;
+    EvalState state;
+    program.setPrecomputeBudget(precompute);
+    program.setRunLimits(limits);
+    state.setOutput(out);
+    if (input) state.setInput(input);
+    else state.setInput(empty);
+    bool cached = !cache.empty() && loadCachedProgram(cache, text, program);
+    bool cacheable = !cache.empty() && !cached;
+    std::string line;
+    while (!cached && getline(source, line) && !state.isQuitRequested()) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        if (!isdigit((unsigned char) trim(line)[0])) cacheable = false;
+        try {
+            processLine(line, program, state);
+        } catch (ErrorException &ex) {
+            out << ex.getMessage() << std::endl;
+        }
+    }
+    if (cacheable && out.str().empty()) {
+        saveCachedProgram(cache, text, program);
+    }
+    if (!state.isQuitRequested()) {
+        try {
+            program.run_program_(state);
+        } catch (ErrorException &ex) {
+            out << ex.getMessage() << std::endl;
+        }
+    }
+    job.text = out.str();
+}
+
+int runBatch(const std::string &dir, int workers, bool merged, long precompute, const RunLimits &limits,
+             const std::string &cache) {
+    namespace fs = std::filesystem;
+    std::vector<BatchJob> jobs;
+    std::error_code failure;
+    for (const fs::directory_entry &entry : fs::directory_iterator(dir, failure)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".bas") continue;
+        BatchJob job;
+        fs::path path = entry.path();
+        job.program = path.string();
+        job.input = fs::path(path).replace_extension(".in").string();
+        job.output = fs::path(path).replace_extension(".out").string();
+        jobs.push_back(job);
+    }
+    if (failure) {
+        std::cerr << "Cannot read " << dir << ": " << failure.message() << std::endl;
+        return 1;
+    }
+    std::sort(jobs.begin(), jobs.end(), [](const BatchJob &a, const BatchJob &b) {
+        return a.program < b.program;
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    std::mutex lock;
+    std::condition_variable finished;
+    size_t bytes = 0;
+    int threads;
+    {
+        ThreadPool pool(workers);
+        threads = pool.size();
+        for (BatchJob &job : jobs) {
+            pool.submit([&job, &lock, &finished, &limits, &cache, merged, precompute] {
+                runJob(job, precompute, limits, cache);
+                if (!merged && job.readable) {
+                    std::ofstream(job.output) << job.text;
+                    job.text.clear();
+                }
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    job.done = true;
+                }
+                finished.notify_all();
+            });
+        }
+        for (BatchJob &job : jobs) {
+            std::unique_lock<std::mutex> guard(lock);
+            finished.wait(guard, [&job] { return job.done; });
+            guard.unlock();
+            if (merged) {
+                std::cout << job.text;
+                bytes += job.text.size();
+                job.text.clear();
+                job.text.shrink_to_fit();
+            }
+        }
+    }
+    std::cout.flush();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int failed = 0;
+    for (BatchJob &job : jobs) {
+        if (!job.readable) {
+            std::cerr << "Cannot read " << job.program << std::endl;
+            ++failed;
+        }
+    }
+    std::cerr << jobs.size() << " programs on " << threads << " threads in " << seconds << " s ("
+              << (seconds > 0 ? jobs.size() / seconds : 0) << " programs/s";
+    if (merged) std::cerr << ", " << bytes << " bytes of output";
+    std::cerr << ")" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,39 @@
+/*
+ * File: batch.h
+ * -------------
+ * This interface exports the batch mode of the interpreter, which runs
+ * every program in a directory in one process.
+ */
+
+#ifndef _batch_h
+#define _batch_h
+
+#include <string>
+#include "program.hpp"
+
+/*
+ * Function: runBatch
+ * Usage: return runBatch(dir, workers, merged, precompute, limits, cache);
+ * ------------------------------------------------------------------------
+ * Runs every file name.bas in the directory dir.  Each file is a program
+ * listing: its lines are passed to processLine in order, as if typed at
+ * the console, and the program is then RUN, with INPUT reading the
+ * lines of name.in if that file exists.  Every program has its own
+ * Program and EvalState, and the programs are spread over a pool of
+ * workers threads, or one per core if workers is not positive.
+ *
+ * The output of each program, including any error messages, goes to
+ * name.out next to it, or, if merged is true, to standard output in the
+ * order of the file names.  precompute and limits are passed to
+ * Program::setPrecomputeBudget and Program::setRunLimits.  Unless cache
+ * is empty, it names the directory of the image cache, through which
+ * a file that has been loaded before is loaded again without passing
+ * its lines to processLine.  When all programs are done, a line of
+ * statistics is written to standard error.  The function returns zero
+ * if every program could be read.
+ */
+
+int runBatch(const std::string &dir, int workers, bool merged, long precompute, const RunLimits &limits,
+             const std::string &cache);
+
+#endif
@@ -0,0 +1,294 @@
+/*
+ * File: compiled.cpp
+ * ------------------
+ * Implements the compiled.h interface.
+ */
+
+#include <mutex>
+#include <set>
+#include <utility>
+#include "compiled.hpp"
+#include "exp.hpp"
+#include "optimizer.hpp"
+#include "statement.hpp"
+#include "Utils/error.hpp"
+
+CompiledProgram::CompiledProgram(std::map<int, std::unique_ptr<Statement>> lines, const LineStore &source)
+        : lines_(std::move(lines)), source_(source) {
+    linkParallelLoops();
+    flow_.build(*this);
+    hoistInvariants(*this, flow_);
+    fused_ = fuseCountedLoops(*this, flow_);
+    flattenExpressions(*this, table_);
+    for (auto iter = lines_.begin(); iter != lines_.end(); ++iter) {
+        code_[(*iter).first] = (*iter).second.get();
+        if ((*iter).second->getType() == INPUT_STMT && flow_.isReachable((*iter).first)) {
+            input_free_ = false;
+        }
+    }
+    for (auto iter = fused_.begin(); iter != fused_.end(); ++iter) {
+        code_[(*iter).first] = (*iter).second.get();
+    }
+}
+
+static void collectVariables(Expression *exp, std::set<int> &read, std::set<int> &assigned) {
+    switch (exp->getType()) {
+    case IDENTIFIER:
+        read.insert(((IdentifierExp *) exp)->getSymbol());
+        break;
+    case COMPOUND: {
+        CompoundExp *compound = (CompoundExp *) exp;
+        if (compound->getOp() == "=") assigned.insert(((IdentifierExp *) compound->getLHS())->getSymbol());
+        else collectVariables(compound->getLHS(), read, assigned);
+        collectVariables(compound->getRHS(), read, assigned);
+        break;
+    }
+    case SHARED:
+        collectVariables(((SharedExp *) exp)->getExp(), read, assigned);
+        break;
+    case POOLED:
+        collectVariables(((PooledExp *) exp)->getExp(), read, assigned);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Implementation notes: findLocals
+ * --------------------------------
+ * The locals of a body are the variables it assigns other than the
+ * loop variable and the reduction variables.  A forward pass over the
+ * body finds the variables assigned on every path from its first line
+ * to each line, intersecting the sets where paths meet and repeating
+ * until none shrinks; the NEXT line ends a path, since each iteration
+ * starts afresh.  A statement is taken to read its variables before it
+ * assigns any, which may refuse a body that is in fact safe but never
+ * accepts one that is not.
+ */
+
+static std::vector<int> findLocals(const std::map<int, std::unique_ptr<Statement>> &lines, int open, int next) {
+    std::vector<int> body;
+    std::map<int, int> index;
+    for (auto iter = lines.upper_bound(open); (*iter).first != next; ++iter) {
+        index[(*iter).first] = (int) body.size();
+        body.push_back((*iter).first);
+    }
+    int size = (int) body.size();
+    std::vector<std::set<int>> reads(size), writes(size);
+    std::vector<std::vector<int>> successors(size);
+    std::set<int> locals;
+    for (int i = 0; i < size; ++i) {
+        Statement *stmt = (*lines.find(body[i])).second.get();
+        for (Expression **root : stmt->getExpressions()) {
+            collectVariables(*root, reads[i], writes[i]);
+        }
+        locals.insert(writes[i].begin(), writes[i].end());
+        StatementType type = stmt->getType();
+        if (type != GOTO_STMT) successors[i].push_back(i + 1);
+        if (type == GOTO_STMT || type == IF_STMT) {
+            int target = ((Control *) stmt)->getTarget();
+            auto found = index.find(target);
+            if (target == next) successors[i].push_back(size);
+            else if (found != index.end()) successors[i].push_back(target == body[i] ? i + 1 : (*found).second);
+        }
+    }
+    PARALLEL *loop = (PARALLEL *) (*lines.find(open)).second.get();
+    locals.erase(loop->getVariable());
+    for (auto &reduction : loop->getReductions()) {
+        locals.erase(reduction.second);
+    }
+    std::vector<std::set<int>> before(size + 1);
+    std::vector<bool> reached(size + 1, false);
+    reached[0] = true;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < size; ++i) {
+            if (!reached[i]) continue;
+            std::set<int> after = before[i];
+            after.insert(writes[i].begin(), writes[i].end());
+            for (int successor : successors[i]) {
+                std::set<int> &known = before[successor];
+                if (!reached[successor]) {
+                    reached[successor] = true;
+                    known = after;
+                    changed = true;
+                    continue;
+                }
+                for (auto iter = known.begin(); iter != known.end();) {
+                    if (after.count(*iter) == 0) {
+                        iter = known.erase(iter);
+                        changed = true;
+                    }
+                    else {
+                        ++iter;
+                    }
+                }
+            }
+        }
+    }
+    for (int i = 0; i < size; ++i) {
+        if (!reached[i]) continue;
+        for (int variable : reads[i]) {
+            if (locals.count(variable) != 0 && before[i].count(variable) == 0) error("PARALLEL FOR ERROR");
+        }
+    }
+    return std::vector<int>(locals.begin(), locals.end());
+}
+
+/*
+ * Implementation notes: linkParallelLoops
+ * ---------------------------------------
+ * Each PARALLEL FOR is paired with the first NEXT after it, so loops
+ * cannot nest.  A jump is part of a body if its line lies after the
+ * PARALLEL FOR and not after the NEXT, and it must then stay in that
+ * range; any other jump must stay out of it.
+ */
+
+void CompiledProgram::linkParallelLoops() {
+    std::vector<std::pair<int, int>> loops;
+    int open = -1;
+    for (auto iter = lines_.begin(); iter != lines_.end(); ++iter) {
+        StatementType type = (*iter).second->getType();
+        if (type == PARALLEL_STMT) {
+            if (open != -1) error("PARALLEL FOR ERROR");
+            open = (*iter).first;
+        }
+        else if (type == NEXT_STMT) {
+            if (open == -1) error("PARALLEL FOR ERROR");
+            PARALLEL *loop = (PARALLEL *) lines_[open].get();
+            if (loop->getVariable() != ((NEXT *) (*iter).second.get())->getVariable()) error("PARALLEL FOR ERROR");
+            loops.push_back({open, (*iter).first});
+            open = -1;
+        }
+        else if (open != -1 && (type == INPUT_STMT || type == PRINT_STMT || type == END_STMT)) {
+            error("PARALLEL FOR ERROR");
+        }
+    }
+    if (open != -1) error("PARALLEL FOR ERROR");
+    if (loops.empty()) return;
+    parallel_ = true;
+    for (auto iter = lines_.begin(); iter != lines_.end(); ++iter) {
+        StatementType type = (*iter).second->getType();
+        if (type != GOTO_STMT && type != IF_STMT) continue;
+        int line = (*iter).first;
+        int target = ((Control *) (*iter).second.get())->getTarget();
+        for (auto &loop : loops) {
+            bool inside = line > loop.first && line <= loop.second;
+            bool into = target > loop.first && target <= loop.second;
+            if (inside != into) error("PARALLEL FOR ERROR");
+        }
+    }
+    for (auto &loop : loops) {
+        ((PARALLEL *) lines_[loop.first].get())->link(loop.first, loop.second, findLocals(lines_, loop.first, loop.second));
+    }
+}
+
+int CompiledProgram::getFirstLineNumber() const {
+    return lines_.empty() ? -1 : (*lines_.begin()).first;
+}
+
+int CompiledProgram::getNextLineNumber(int lineNumber) const {
+    auto iter = lines_.upper_bound(lineNumber);
+    return iter == lines_.end() ? -1 : (*iter).first;
+}
+
+Statement *CompiledProgram::getParsedStatement(int lineNumber) const {
+    auto iter = lines_.find(lineNumber);
+    return iter == lines_.end() ? nullptr : (*iter).second.get();
+}
+
+bool CompiledProgram::hasLine(int lineNumber) const {
+    return lines_.count(lineNumber) != 0;
+}
+
+Statement *CompiledProgram::getCode(int lineNumber) const {
+    return (*code_.find(lineNumber)).second;
+}
+
+const FlowGraph &CompiledProgram::getFlowGraph() const {
+    return flow_;
+}
+
+bool CompiledProgram::isInputFree() const {
+    return input_free_;
+}
+
+bool CompiledProgram::hasParallel() const {
+    return parallel_;
+}
+
+void CompiledProgram::measure(MemoryStats &stats) const {
+    stats.source += source_.getBytes();
+    stats.lines += treeBytes(lines_.size(), sizeof(std::pair<const int, std::unique_ptr<Statement>>));
+    stats.lines += treeBytes(fused_.size(), sizeof(std::pair<const int, std::unique_ptr<Statement>>));
+    stats.lines += hashBytes(code_.size(), code_.bucket_count(), sizeof(std::pair<const int, Statement *>));
+    stats.lines += flow_.getBytes();
+    for (auto iter = lines_.begin(); iter != lines_.end(); ++iter) {
+        stats.statements += measureStatement((*iter).second.get());
+        for (Expression **root : (*iter).second->getExpressions()) {
+            stats.expressions += measureExpression(*root);
+        }
+    }
+    for (auto iter = fused_.begin(); iter != fused_.end(); ++iter) {
+        stats.statements += measureStatement((*iter).second.get());
+    }
+    stats.expressions += table_.getBytes();
+}
+
+/*
+ * Implementation notes: find, publish
+ * -----------------------------------
+ * The table holds weak pointers, so a version is freed as soon as the
+ * last program and run using it let it go.  It is keyed by the hash of
+ * the source, which LineStore keeps up to date as lines are edited, so
+ * looking a program up costs nothing in proportion to its size unless
+ * a version with the same hash is found, whose source is then compared
+ * line by line.  Entries whose version is gone are dropped whenever a
+ * lookup meets them, and all of them are swept whenever the table has
+ * doubled since the last sweep.
+ */
+
+namespace {
+    std::mutex registryLock;
+    std::unordered_multimap<uint64_t, std::weak_ptr<const CompiledProgram>> registry;
+    size_t sweepAt = 64;
+}
+
+std::shared_ptr<const CompiledProgram> CompiledProgram::findLocked(const LineStore &source) {
+    auto range = registry.equal_range(source.getHash());
+    for (auto iter = range.first; iter != range.second;) {
+        std::shared_ptr<const CompiledProgram> image = (*iter).second.lock();
+        if (!image) {
+            iter = registry.erase(iter);
+        }
+        else if (image->source_.sameLines(source)) {
+            return image;
+        }
+        else {
+            ++iter;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const CompiledProgram> CompiledProgram::find(const LineStore &source) {
+    std::lock_guard<std::mutex> guard(registryLock);
+    return findLocked(source);
+}
+
+std::shared_ptr<const CompiledProgram> CompiledProgram::publish(std::shared_ptr<const CompiledProgram> image) {
+    std::lock_guard<std::mutex> guard(registryLock);
+    std::shared_ptr<const CompiledProgram> existing = findLocked(image->source_);
+    if (existing) return existing;
+    registry.emplace(image->source_.getHash(), image);
+    if (registry.size() >= sweepAt) {
+        for (auto iter = registry.begin(); iter != registry.end();) {
+            if ((*iter).second.expired()) iter = registry.erase(iter);
+            else ++iter;
+        }
+        sweepAt = 2 * registry.size() + 64;
+    }
+    return image;
+}
@@ -0,0 +1,167 @@
+/*
+ * File: compiled.h
+ * ----------------
+ * This interface exports the CompiledProgram class, the form of a
+ * BASIC program that is actually executed.
+ */
+
+#ifndef _compiled_h
+#define _compiled_h
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "exptable.hpp"
+#include "flowgraph.hpp"
+#include "linestore.hpp"
+#include "memory.hpp"
+
+class Statement;
+
+/*
+ * Class: CompiledProgram
+ * ----------------------
+ * A CompiledProgram is one version of a program: its parsed lines
+ * after loop analysis, invariant hoisting and loop fusion, with their
+ * expressions flattened into one ExpressionTable.  It is never
+ * changed after it has been built, and everything that changes while
+ * a program runs lives in the EvalState and in the Program that runs
+ * it, so one CompiledProgram can be executed by many runs on many
+ * threads at once.  Versions are handed out as shared pointers: an edit
+ * to a Program makes it build a new version at its next run, and runs
+ * in progress keep the version they started with.
+ */
+
+class CompiledProgram {
+
+public:
+
+/*
+ * Constructor: CompiledProgram
+ * Usage: CompiledProgram image(std::move(lines), source);
+ * -------------------------------------------------------
+ * Builds a version from the parsed statements of its lines, indexed by
+ * line number, and keeps a copy of source, the text of those lines,
+ * under which the version is shared.  The statements must not have
+ * been optimized before, and they are owned by the new object.  If the
+ * PARALLEL FOR loops of the program break the rules given in
+ * statement.h, the constructor raises an error and the statements are
+ * freed.
+ */
+
+    CompiledProgram(std::map<int, std::unique_ptr<Statement>> lines, const LineStore &source);
+
+    CompiledProgram(const CompiledProgram &) = delete;
+    CompiledProgram &operator=(const CompiledProgram &) = delete;
+
+/*
+ * Methods: getFirstLineNumber, getNextLineNumber, getParsedStatement
+ * ------------------------------------------------------------------
+ * These methods have the same meaning as the methods of Program with
+ * the same names.
+ */
+
+    int getFirstLineNumber() const;
+    int getNextLineNumber(int lineNumber) const;
+    Statement *getParsedStatement(int lineNumber) const;
+
+/*
+ * Method: hasLine
+ * Usage: if (image.hasLine(lineNumber)) . . .
+ * -------------------------------------------
+ * Returns true if the version has a line with the specified number.
+ */
+
+    bool hasLine(int lineNumber) const;
+
+/*
+ * Method: getCode
+ * Usage: Statement *stmt = image.getCode(lineNumber);
+ * ---------------------------------------------------
+ * Returns the statement that is executed for an existing line, which
+ * is the parsed statement unless the line starts a fused loop.
+ */
+
+    Statement *getCode(int lineNumber) const;
+
+/*
+ * Method: getFlowGraph
+ * Usage: const FlowGraph &flow = image.getFlowGraph();
+ * ----------------------------------------------------
+ * Returns the control flow graph of the version.
+ */
+
+    const FlowGraph &getFlowGraph() const;
+
+/*
+ * Method: isInputFree
+ * Usage: if (image.isInputFree()) . . .
+ * -------------------------------------
+ * Returns true if no INPUT statement can be reached from the first
+ * line.
+ */
+
+    bool isInputFree() const;
+
+/*
+ * Method: hasParallel
+ * Usage: if (image.hasParallel()) . . .
+ * -------------------------------------
+ * Returns true if the version contains a PARALLEL FOR.
+ */
+
+    bool hasParallel() const;
+
+/*
+ * Method: measure
+ * Usage: image.measure(stats);
+ * ----------------------------
+ * Adds the memory used by the version to stats: its copy of the text
+ * to source, its line tables and flow graph to lines, its statements,
+ * including the fused ones, to statements, and its expression table to
+ * expressions.
+ */
+
+    void measure(MemoryStats &stats) const;
+
+/*
+ * Methods: find, publish
+ * Usage: std::shared_ptr<const CompiledProgram> image = CompiledProgram::find(source);
+ *        image = CompiledProgram::publish(image);
+ * -----------------------------------------------------------------------------------
+ * Share versions between programs with the same text.  publish records
+ * a version under the hash of its source and returns it, or returns
+ * the version recorded for the same text in the meantime, if any; find
+ * returns the version recorded for the lines of source if any program
+ * still uses it, or nullptr otherwise.  Both may be called from any
+ * thread.
+ */
+
+    static std::shared_ptr<const CompiledProgram> find(const LineStore &source);
+    static std::shared_ptr<const CompiledProgram> publish(std::shared_ptr<const CompiledProgram> image);
+
+private:
+
+    //行号->解析后的语句。
+    std::map<int, std::unique_ptr<Statement>> lines_;
+    //行号->运行时执行的语句：一般为lines_中的语句，可融合的行为CountedLoop。
+    std::unordered_map<int, Statement *> code_;
+    std::map<int, std::unique_ptr<Statement>> fused_;
+    FlowGraph flow_;
+    //各语句表达式的节点。
+    ExpressionTable table_;
+    bool input_free_ = true;
+    bool parallel_ = false;
+    //构建本版本的各行的文本，登记表凭此核对。
+    LineStore source_;
+
+    //检查PARALLEL FOR的循环体并将其与对应的NEXT行相连。
+    void linkParallelLoops();
+
+    //在登记表中找文本与source相同的版本，调用者须持有登记表的锁。
+    static std::shared_ptr<const CompiledProgram> findLocked(const LineStore &source);
+
+};
+
+#endif
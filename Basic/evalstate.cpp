@@ -7,7 +7,12 @@
  */
 
 
+#include <algorithm>
 #include "evalstate.hpp"
+#include "symbols.hpp"
+#include "memory.hpp"
+#include "varstore.hpp"
+#include "Utils/error.hpp"
 
 
 //using namespace std;
@@ -15,27 +20,273 @@
 /* Implementation of the EvalState class */
 
 EvalState::EvalState() {
-    /* Empty */
+    count = 0;
+    store = nullptr;
+    mirrored = false;
+    output = &std::cout;
+    input = &std::cin;
+    quit = false;
+    suspends = false;
+    waiting = false;
+    prompted = false;
+    stamp = 1;
+    loopStamp = 0;
 }
 
 EvalState::~EvalState() {
     /* Empty */
 }
 
-void EvalState::setValue(std::string var, int value) {
-    if(isDefined(var)) symbolTable[var] = value;
-    else symbolTable.emplace(var,value);
+/*
+ * Implementation notes: variables
+ * -------------------------------
+ * Symbols are shared by every program of the process and never freed,
+ * so in a long-lived process a program may use a few variables whose
+ * symbols are large.  The values of symbols below DENSE_SLACK plus four
+ * times the number of defined variables are kept in vectors indexed by
+ * the symbol, and the others in the sparse map, so the memory of a
+ * state grows with its variables rather than with the largest symbol.
+ * A variable stays where it was first set until it is removed.
+ */
+
+namespace {
+
+const int DENSE_SLACK = 1024;
+
+}
+
+void EvalState::setValue(int symbol, int value) {
+    if (symbol < (int) defined.size() && defined[symbol]) {
+        values[symbol] = value;
+    }
+    else if (!sparse.empty() && sparse.count(symbol) != 0) {
+        sparse[symbol] = value;
+    }
+    else if (symbol < (int) values.size() || symbol < DENSE_SLACK + 4 * count) {
+        if (symbol >= (int) values.size()) {
+            values.resize(symbol + 1, 0);
+            defined.resize(symbol + 1, 0);
+        }
+        defined[symbol] = 1;
+        values[symbol] = value;
+        ++count;
+    }
+    else {
+        sparse[symbol] = value;
+        ++count;
+    }
+    if (mirrored) store->set(symbol, value);
+}
+
+void EvalState::setValue(const std::string &var, int value) {
+    setValue(internSymbol(var), value);
+}
+
+void EvalState::removeValue(int symbol) {
+    if (symbol < (int) defined.size() && defined[symbol]) defined[symbol] = 0;
+    else if (sparse.empty() || sparse.erase(symbol) == 0) return;
+    --count;
+    if (mirrored) store->rewrite(*this);
+}
+
+int EvalState::getValue(int symbol) const {
+    if (symbol < (int) defined.size() && defined[symbol]) return values[symbol];
+    if (!sparse.empty()) {
+        auto iter = sparse.find(symbol);
+        if (iter != sparse.end()) return (*iter).second;
+    }
+    return 0;
+}
+
+int EvalState::getValue(const std::string &var) const {
+    return getValue(internSymbol(var));
+}
+
+bool EvalState::isDefined(int symbol) const {
+    if (symbol < (int) defined.size() && defined[symbol]) return true;
+    return !sparse.empty() && sparse.count(symbol) != 0;
 }
 
-int EvalState::getValue(std::string var) {
-    if(isDefined(var)) return symbolTable[var];
-    else return 0;
+bool EvalState::isDefined(const std::string &var) const {
+    return isDefined(internSymbol(var));
 }
 
-bool EvalState::isDefined(std::string var) {
-    return symbolTable.find(var)!=symbolTable.end();
+int EvalState::getVariableCount() const {
+    return count;
+}
+
+std::vector<std::pair<int, int>> EvalState::getVariables() const {
+    std::vector<std::pair<int, int>> variables;
+    for (size_t symbol = 0; symbol < defined.size(); ++symbol) {
+        if (defined[symbol]) variables.push_back({(int) symbol, values[symbol]});
+    }
+    if (!sparse.empty()) {
+        variables.insert(variables.end(), sparse.begin(), sparse.end());
+        std::sort(variables.begin(), variables.end());
+    }
+    return variables;
+}
+
+void EvalState::setStore(VariableStore *store, bool mirrored) {
+    this->store = store;
+    this->mirrored = store != nullptr && mirrored;
+}
+
+VariableStore *EvalState::getStore() const {
+    return store;
+}
+
+size_t EvalState::getBytes() const {
+    size_t bytes = vectorBytes(values) + vectorBytes(defined) + vectorBytes(temporaries) + vectorBytes(temporaryStamps)
+                   + vectorBytes(loopStamps) + vectorBytes(invariants) + vectorBytes(invariantStamps);
+    bytes += hashBytes(sparse.size(), sparse.bucket_count(), sizeof(std::pair<const int, int>));
+    for (const std::string &line : supplied) {
+        bytes += sizeof(std::string) + stringBytes(line);
+    }
+    return bytes;
 }
 
 void EvalState::Clear() {
-    symbolTable.clear();
-}
\ No newline at end of file
+    values.clear();
+    defined.clear();
+    sparse.clear();
+    count = 0;
+    if (mirrored) store->clear();
+}
+
+void EvalState::copyVariables(const EvalState &other) {
+    values = other.values;
+    defined = other.defined;
+    sparse = other.sparse;
+    count = other.count;
+    if (mirrored) store->rewrite(*this);
+}
+
+std::ostream &EvalState::getOutput() {
+    return *output;
+}
+
+void EvalState::setOutput(std::ostream &out) {
+    output = &out;
+}
+
+std::istream &EvalState::getInput() {
+    return *input;
+}
+
+void EvalState::setInput(std::istream &in) {
+    input = &in;
+}
+
+void EvalState::setInputSuspends(bool suspends) {
+    this->suspends = suspends;
+}
+
+void EvalState::supplyInput(const std::string &line) {
+    supplied.push_back(line);
+    waiting = false;
+}
+
+bool EvalState::readInput(std::string &line) {
+    if (suspends) {
+        if (supplied.empty()) {
+            waiting = true;
+            return false;
+        }
+        line = supplied.front();
+        supplied.pop_front();
+        waiting = false;
+        return true;
+    }
+    waiting = false;
+    if (!getline(*input, line)) {
+        prompted = false;
+        error("END OF INPUT");
+    }
+    return true;
+}
+
+bool EvalState::isWaitingForInput() {
+    return waiting;
+}
+
+bool EvalState::isInputPrompted() {
+    return prompted;
+}
+
+void EvalState::setInputPrompted(bool prompted) {
+    this->prompted = prompted;
+}
+
+void EvalState::requestQuit() {
+    quit = true;
+}
+
+bool EvalState::isQuitRequested() {
+    return quit;
+}
+
+/*
+ * Implementation notes: temporaries
+ * ---------------------------------
+ * Each slot remembers the stamp that was current when it was written,
+ * so a reset is a single increment instead of a pass over the slots.
+ * The slots are only cleared when the stamp wraps around.
+ */
+
+void EvalState::resetTemporaries() {
+    if (++stamp == 0) {
+        temporaryStamps.assign(temporaryStamps.size(), 0);
+        stamp = 1;
+    }
+}
+
+bool EvalState::lookupTemporary(int slot, int &value) {
+    if (slot >= (int) temporaries.size() || temporaryStamps[slot] != stamp) return false;
+    value = temporaries[slot];
+    return true;
+}
+
+void EvalState::setTemporary(int slot, int value) {
+    if (slot >= (int) temporaries.size()) {
+        temporaries.resize(slot + 1);
+        temporaryStamps.resize(slot + 1, 0);
+    }
+    temporaries[slot] = value;
+    temporaryStamps[slot] = stamp;
+}
+
+/*
+ * Implementation notes: invariants
+ * --------------------------------
+ * Every entry into a loop hands it a fresh stamp, and an invariant
+ * slot is valid only if it carries the current stamp of its loop.
+ * Stamp zero is never handed out, so slots of loops that have not been
+ * entered yet are never valid.
+ */
+
+void EvalState::enterLoop(int loop) {
+    if (loop >= (int) loopStamps.size()) loopStamps.resize(loop + 1, 0);
+    if (++loopStamp == 0) {
+        loopStamps.assign(loopStamps.size(), 0);
+        invariantStamps.assign(invariantStamps.size(), 0);
+        loopStamp = 1;
+    }
+    loopStamps[loop] = loopStamp;
+}
+
+bool EvalState::lookupInvariant(int loop, int slot, int &value) {
+    if (slot >= (int) invariants.size() || loop >= (int) loopStamps.size()) return false;
+    if (loopStamps[loop] == 0 || invariantStamps[slot] != loopStamps[loop]) return false;
+    value = invariants[slot];
+    return true;
+}
+
+void EvalState::setInvariant(int loop, int slot, int value) {
+    if (slot >= (int) invariants.size()) {
+        invariants.resize(slot + 1);
+        invariantStamps.resize(slot + 1, 0);
+    }
+    invariants[slot] = value;
+    invariantStamps[slot] = loop < (int) loopStamps.size() ? loopStamps[loop] : 0;
+}
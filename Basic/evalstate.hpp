@@ -10,7 +10,13 @@
 #define _evalstate_h
 
 #include <string>
-#include <map>
+#include <vector>
+#include <deque>
+#include <iostream>
+#include <unordered_map>
+#include <utility>
+
+class VariableStore;
 
 /*
  * Class: EvalState
@@ -19,7 +25,8 @@
  * of the evaluator and contains information from the evaluation
  * environment that the evaluator may need to know.  In this
  * version, the only information maintained by the EvalState class
- * is a symbol table that maps variable names into their values.
+ * is a symbol table that maps variables, identified by the symbols
+ * of their names, into their values.
  * In your implementation, you may include additional information
  * in the EvalState class.
  */
@@ -48,36 +55,272 @@ public:
 
 /*
  * Method: setValue
- * Usage: state.setValue(var, value);
- * ----------------------------------
- * Sets the value associated with the specified var.
+ * Usage: state.setValue(symbol, value);
+ * -------------------------------------
+ * Sets the value associated with the variable whose symbol, as given by
+ * internSymbol, is symbol.  The overload that takes a name interns it
+ * first.
+ */
+
+    void setValue(int symbol, int value);
+
+    void setValue(const std::string &var, int value);
+
+/*
+ * Method: removeValue
+ * Usage: state.removeValue(symbol);
+ * ---------------------------------
+ * Makes the variable whose symbol is symbol undefined, if it is
+ * defined.
  */
 
-    void setValue(std::string var, int value);
+    void removeValue(int symbol);
 
 /*
  * Method: getValue
- * Usage: int value = state.getValue(var);
- * ---------------------------------------
- * Returns the value associated with the specified variable.
+ * Usage: int value = state.getValue(symbol);
+ * ------------------------------------------
+ * Returns the value associated with the specified variable, or 0 if it
+ * is not defined.
  */
 
-    int getValue(std::string var);
+    int getValue(int symbol) const;
+
+    int getValue(const std::string &var) const;
 
 /*
  * Method: isDefined
- * Usage: if (state.isDefined(var)) . . .
- * --------------------------------------
+ * Usage: if (state.isDefined(symbol)) . . .
+ * -----------------------------------------
  * Returns true if the specified variable is defined.
  */
 
-    bool isDefined(std::string var);
+    bool isDefined(int symbol) const;
+
+    bool isDefined(const std::string &var) const;
+
+/*
+ * Method: getVariableCount
+ * Usage: int count = state.getVariableCount();
+ * --------------------------------------------
+ * Returns the number of variables that are defined.
+ */
+
+    int getVariableCount() const;
+
+/*
+ * Method: getVariables
+ * Usage: for (auto &variable : state.getVariables()) . . .
+ * --------------------------------------------------------
+ * Returns the symbol and the value of each defined variable, in the
+ * order of the symbols.
+ */
+
+    std::vector<std::pair<int, int>> getVariables() const;
+
+/*
+ * Methods: setStore, getStore
+ * Usage: state.setStore(&store, mirrored);
+ * ----------------------------------------
+ * Set or return the VariableStore used by the SAVEVARS and LOADVARS
+ * commands, or nullptr if there is none.  If mirrored is true, every
+ * change to the variables is also passed to the store, as
+ * VariableStore::attach requires; copies made with copyVariables are
+ * never attached.
+ */
+
+    void setStore(VariableStore *store, bool mirrored);
+
+    VariableStore *getStore() const;
+
+/*
+ * Method: getBytes
+ * Usage: size_t bytes = state.getBytes();
+ * ---------------------------------------
+ * Returns the bytes of heap memory used by the variables, the slots of
+ * temporaries and invariants and the queued lines of input.
+ */
+
+    size_t getBytes() const;
 
     void Clear();
 
+/*
+ * Method: copyVariables
+ * Usage: state.copyVariables(other);
+ * ----------------------------------
+ * Replaces the variable bindings of this state with those of another
+ * one.  The output stream is not touched.
+ */
+
+    void copyVariables(const EvalState &other);
+
+/*
+ * Methods: getOutput, setOutput
+ * Usage: state.getOutput() << value << '\n';
+ *        state.setOutput(stream);
+ * ------------------------------------------
+ * Return or change the stream that PRINT and INPUT write to.  A new
+ * EvalState writes to std::cout.
+ */
+
+    std::ostream &getOutput();
+
+    void setOutput(std::ostream &out);
+
+/*
+ * Methods: getInput, setInput
+ * Usage: getline(state.getInput(), line);
+ *        state.setInput(stream);
+ * ---------------------------------------
+ * Return or change the stream that INPUT reads from.  A new EvalState
+ * reads from std::cin.
+ */
+
+    std::istream &getInput();
+
+    void setInput(std::istream &in);
+
+/*
+ * Method: setInputSuspends
+ * Usage: state.setInputSuspends(true);
+ * ------------------------------------
+ * Chooses where INPUT gets its lines.  By default it reads them from
+ * the input stream and waits for the user.  When suspends is true, it
+ * takes the lines passed to supplyInput instead, and if none is left
+ * it marks the state as waiting for input so that the run suspends.
+ */
+
+    void setInputSuspends(bool suspends);
+
+/*
+ * Method: supplyInput
+ * Usage: state.supplyInput(line);
+ * -------------------------------
+ * Queues a line for INPUT to read when the state suspends on input.
+ */
+
+    void supplyInput(const std::string &line);
+
+/*
+ * Method: readInput
+ * Usage: if (state.readInput(line)) . . .
+ * ---------------------------------------
+ * Reads the next line for INPUT.  Returns false, and marks the state as
+ * waiting for input, if the state suspends on input and no line has
+ * been supplied.  Raises END OF INPUT if the input stream is exhausted.
+ */
+
+    bool readInput(std::string &line);
+
+/*
+ * Method: isWaitingForInput
+ * Usage: if (state.isWaitingForInput()) . . .
+ * -------------------------------------------
+ * Returns true if the last INPUT found no line to read.  Supplying a
+ * line clears the condition.
+ */
+
+    bool isWaitingForInput();
+
+/*
+ * Methods: isInputPrompted, setInputPrompted
+ * Usage: if (!state.isInputPrompted()) . . .
+ * ------------------------------------------
+ * Record whether INPUT has printed its prompt for the line it is
+ * waiting for, so that a suspended INPUT does not print it twice.
+ */
+
+    bool isInputPrompted();
+
+    void setInputPrompted(bool prompted);
+
+/*
+ * Methods: requestQuit, isQuitRequested
+ * Usage: state.requestQuit();
+ *        if (state.isQuitRequested()) . . .
+ * ----------------------------------------
+ * Record and report that the user has typed QUIT.  Ending the session
+ * is left to whoever reads the lines.
+ */
+
+    void requestQuit();
+
+    bool isQuitRequested();
+
+/*
+ * Method: resetTemporaries
+ * Usage: state.resetTemporaries();
+ * --------------------------------
+ * Forgets the values of all temporary slots.  A statement calls this
+ * before evaluating its expressions so that shared subexpressions are
+ * computed afresh on each execution.
+ */
+
+    void resetTemporaries();
+
+/*
+ * Methods: lookupTemporary, setTemporary
+ * Usage: if (state.lookupTemporary(slot, value)) . . .
+ *        state.setTemporary(slot, value);
+ * ---------------------------------------------------
+ * Reads or writes the temporary slot used by a SharedExp.  The lookup
+ * returns false if the slot has not been set since the last reset.
+ */
+
+    bool lookupTemporary(int slot, int &value);
+
+    void setTemporary(int slot, int value);
+
+/*
+ * Method: enterLoop
+ * Usage: state.enterLoop(loop);
+ * -----------------------------
+ * Records that control has entered the given loop from outside, which
+ * invalidates the values cached for its invariant expressions.
+ */
+
+    void enterLoop(int loop);
+
+/*
+ * Methods: lookupInvariant, setInvariant
+ * Usage: if (state.lookupInvariant(loop, slot, value)) . . .
+ *        state.setInvariant(loop, slot, value);
+ * ---------------------------------------------------------
+ * Reads or writes the slot used by a HoistedExp of the given loop.
+ * The lookup returns false if the slot has not been set since control
+ * last entered the loop.
+ */
+
+    bool lookupInvariant(int loop, int slot, int &value);
+
+    void setInvariant(int loop, int slot, int value);
+
 private:
 
-    std::map<std::string, int> symbolTable;
+    //以符号为下标的变量值，defined标记已定义的变量，count为其个数。
+    std::vector<int> values;
+    std::vector<char> defined;
+    int count;
+    //符号超出values范围的变量->值，见setValue。
+    std::unordered_map<int, int> sparse;
+    //SAVEVARS与LOADVARS所用的文件；mirrored时每次修改变量都同步写入。
+    VariableStore *store;
+    bool mirrored;
+    std::ostream *output;
+    std::istream *input;
+    bool quit;
+    bool suspends;
+    bool waiting;
+    bool prompted;
+    std::deque<std::string> supplied;
+    std::vector<int> temporaries;
+    std::vector<unsigned> temporaryStamps;
+    unsigned stamp;
+    std::vector<unsigned> loopStamps;
+    std::vector<int> invariants;
+    std::vector<unsigned> invariantStamps;
+    unsigned loopStamp;
 
 };
 
@@ -5,6 +5,9 @@
  */
 
 #include "exp.hpp"
+#include "exptable.hpp"
+#include "exppool.hpp"
+#include "symbols.hpp"
 
 
 /*
@@ -49,29 +52,34 @@ int ConstantExp::getValue() {
  * Implementation notes: the IdentifierExp subclass
  * ------------------------------------------------
  * The IdentifierExp subclass declares a single instance variable that
- * stores the name of the variable.  The implementation of eval must
- * look this variable up in the evaluation state.
+ * stores the symbol of the variable, so the name is kept only once in
+ * the table of symbols.  The implementation of eval must look this
+ * variable up in the evaluation state.
  */
 
 IdentifierExp::IdentifierExp(std::string name) {
-    this->name = name;
+    symbol = internSymbol(name);
 }
 
 int IdentifierExp::eval(EvalState &state) {
-    if (!state.isDefined(name)) error("VARIABLE NOT DEFINED");
-    return state.getValue(name);
+    if (!state.isDefined(symbol)) error("VARIABLE NOT DEFINED");
+    return state.getValue(symbol);
 }
 
 std::string IdentifierExp::toString() {
-    return name;
+    return getSymbolName(symbol);
 }
 
 ExpressionType IdentifierExp::getType() {
     return IDENTIFIER;
 }
 
-std::string IdentifierExp::getName() {
-    return name;
+const std::string &IdentifierExp::getName() {
+    return getSymbolName(symbol);
+}
+
+int IdentifierExp::getSymbol() {
+    return symbol;
 }
 
 /*
@@ -98,27 +106,27 @@ CompoundExp::~CompoundExp() {
  * --------------------------
  * The eval method for the compound expression case must check for the
  * assignment operator as a special case.  Unlike the arithmetic operators
- * the assignment operator does not evaluate its left operand.
+ * the assignment operator does not evaluate its left operand, which
+ * Statement::validate has already checked to be a variable.  Sums,
+ * differences and products are computed on unsigned values, so that
+ * they wrap around instead of overflowing, and so does division by -1,
+ * since dividing the smallest integer by -1 stops the whole process.
  */
 
 int CompoundExp::eval(EvalState &state) {
     if (op == "=") {
-        if (lhs->getType() != IDENTIFIER) {
-            error("Illegal variable in assignment");
-        }
-        if (lhs->getType() == IDENTIFIER && lhs->toString() == "LET")
-            error("SYNTAX ERROR");
         int val = rhs->eval(state);
-        state.setValue(((IdentifierExp *) lhs)->getName(), val);
+        state.setValue(((IdentifierExp *) lhs)->getSymbol(), val);
         return val;
     }
     int left = lhs->eval(state);
     int right = rhs->eval(state);
-    if (op == "+") return left + right;
-    if (op == "-") return left - right;
-    if (op == "*") return left * right;
+    if (op == "+") return (int) ((unsigned) left + (unsigned) right);
+    if (op == "-") return (int) ((unsigned) left - (unsigned) right);
+    if (op == "*") return (int) ((unsigned) left * (unsigned) right);
     if (op == "/") {
         if (right == 0) error("DIVIDE BY ZERO");
+        if (right == -1) return (int) (0u - (unsigned) left);
         return left / right;
     }
     return 0;
@@ -143,3 +151,166 @@ Expression *CompoundExp::getLHS() {
 Expression *CompoundExp::getRHS() {
     return rhs;
 }
+
+void CompoundExp::setLHS(Expression *lhs) {
+    this->lhs = lhs;
+}
+
+void CompoundExp::setRHS(Expression *rhs) {
+    this->rhs = rhs;
+}
+
+/*
+ * Implementation notes: the SharedExp subclass
+ * --------------------------------------------
+ * The SharedExp subclass keeps the slot number of its temporary and
+ * the expression that computes it.  Every statement that contains
+ * shared occurrences calls resetTemporaries before evaluating, so a
+ * slot holds a value only while the statement that filled it runs.
+ */
+
+SharedExp::SharedExp(int slot, Expression *exp, bool owner) {
+    this->slot = slot;
+    this->exp = exp;
+    this->owner = owner;
+}
+
+SharedExp::~SharedExp() {
+    if (owner) delete exp;
+}
+
+int SharedExp::eval(EvalState &state) {
+    int value;
+    if (state.lookupTemporary(slot, value)) return value;
+    value = exp->eval(state);
+    state.setTemporary(slot, value);
+    return value;
+}
+
+std::string SharedExp::toString() {
+    return exp->toString();
+}
+
+ExpressionType SharedExp::getType() {
+    return SHARED;
+}
+
+int SharedExp::getSlot() {
+    return slot;
+}
+
+Expression *SharedExp::getExp() {
+    return exp;
+}
+
+bool SharedExp::isOwner() {
+    return owner;
+}
+
+/*
+ * Implementation notes: the HoistedExp subclass
+ * ---------------------------------------------
+ * The slot of a HoistedExp is valid as long as control has not left
+ * its loop; the program invalidates it through EvalState::enterLoop
+ * whenever the loop header is reached from outside the loop.
+ */
+
+HoistedExp::HoistedExp(int loop, int slot, Expression *exp) {
+    this->loop = loop;
+    this->slot = slot;
+    this->exp = exp;
+}
+
+HoistedExp::~HoistedExp() {
+    delete exp;
+}
+
+int HoistedExp::eval(EvalState &state) {
+    int value;
+    if (state.lookupInvariant(loop, slot, value)) return value;
+    value = exp->eval(state);
+    state.setInvariant(loop, slot, value);
+    return value;
+}
+
+std::string HoistedExp::toString() {
+    return exp->toString();
+}
+
+ExpressionType HoistedExp::getType() {
+    return HOISTED;
+}
+
+int HoistedExp::getLoop() {
+    return loop;
+}
+
+int HoistedExp::getSlot() {
+    return slot;
+}
+
+Expression *HoistedExp::getExp() {
+    return exp;
+}
+
+/*
+ * Implementation notes: the FlatExp subclass
+ * ------------------------------------------
+ * The FlatExp subclass only names its node; the table owns the nodes
+ * and does the work.
+ */
+
+FlatExp::FlatExp(const ExpressionTable &table, int node) : table(table), node(node) {
+}
+
+int FlatExp::eval(EvalState &state) {
+    return table.eval(node, state);
+}
+
+std::string FlatExp::toString() {
+    return table.toString(node);
+}
+
+ExpressionType FlatExp::getType() {
+    return FLAT;
+}
+
+const ExpressionTable &FlatExp::getTable() {
+    return table;
+}
+
+int FlatExp::getNode() {
+    return node;
+}
+
+/*
+ * Implementation notes: the PooledExp subclass
+ * --------------------------------------------
+ * The PooledExp subclass only holds a reference to the expression in
+ * the pool, which it gives back when it is deleted.
+ */
+
+PooledExp::PooledExp(ExpressionPool *pool, Expression *exp) {
+    this->pool = pool;
+    this->exp = exp;
+}
+
+PooledExp::~PooledExp() {
+    pool->release(exp);
+}
+
+int PooledExp::eval(EvalState &state) {
+    return exp->eval(state);
+}
+
+std::string PooledExp::toString() {
+    return exp->toString();
+}
+
+ExpressionType PooledExp::getType() {
+    return POOLED;
+}
+
+Expression *PooledExp::getExp() {
+    return exp;
+}
@@ -17,14 +17,18 @@
 /*
  * Type: ExpressionType
  * --------------------
- * This enumerated type is used to differentiate the three different
- * expression types: CONSTANT, IDENTIFIER, and COMPOUND.
+ * This enumerated type is used to differentiate the different
+ * expression types: CONSTANT, IDENTIFIER, COMPOUND, SHARED, HOISTED,
+ * FLAT and POOLED.
  */
 
 enum ExpressionType {
-    CONSTANT, IDENTIFIER, COMPOUND
+    CONSTANT, IDENTIFIER, COMPOUND, SHARED, HOISTED, FLAT, POOLED
 };
 
+class ExpressionTable;
+class ExpressionPool;
+
 /*
  * Class: Expression
  * -----------------
@@ -37,6 +41,10 @@ enum ExpressionType {
  *  1. ConstantExp   -- an integer constant
  *  2. IdentifierExp -- a string representing an identifier
  *  3. CompoundExp   -- two expressions combined by an operator
+ *  4. SharedExp     -- a subexpression evaluated once per statement
+ *  5. HoistedExp    -- a subexpression evaluated once per loop entry
+ *  6. FlatExp       -- an expression stored in an ExpressionTable
+ *  7. PooledExp     -- an expression shared by the lines of a program
  *
  * The Expression class defines the interface common to all
  * Expression objects; each subclass provides its own specific
@@ -193,11 +201,22 @@ public:
  * to an object known to be an IdentifierExp.
  */
 
-    std::string getName();
+    const std::string &getName();
+
+/*
+ * Method: getSymbol
+ * Usage: int symbol = ((IdentifierExp *) exp)->getSymbol();
+ * ---------------------------------------------------------
+ * Returns the symbol of the name, as given by internSymbol.  Two
+ * identifiers name the same variable exactly when their symbols are
+ * equal.
+ */
+
+    int getSymbol();
 
 private:
 
-    std::string name;
+    int symbol;
 
 };
 
@@ -254,6 +273,20 @@ public:
 
     Expression *getRHS();
 
+/*
+ * Methods: setLHS, setRHS
+ * Usage: ((CompoundExp *) exp)->setLHS(lhs);
+ *        ((CompoundExp *) exp)->setRHS(rhs);
+ * -----------------------------------------
+ * These methods replace a component of a compound node without freeing
+ * the previous one; they are used by the passes in optimizer.h that
+ * rewrite parsed expressions in place.
+ */
+
+    void setLHS(Expression *lhs);
+
+    void setRHS(Expression *rhs);
+
 private:
 
     std::string op;
@@ -261,4 +294,243 @@ private:
 
 };
 
+/*
+ * Class: SharedExp
+ * ----------------
+ * This subclass stands for one occurrence of a side-effect-free
+ * subexpression that appears several times in the same statement.
+ * All occurrences name the same temporary slot in the EvalState, so
+ * the first one to be evaluated computes the value and the others
+ * reuse it until the statement finishes.  Only the first occurrence
+ * owns the underlying expression; the others merely refer to it.
+ */
+
+class SharedExp : public Expression {
+
+public:
+
+/*
+ * Constructor: SharedExp
+ * Usage: Expression *exp = new SharedExp(slot, exp, owner);
+ * ---------------------------------------------------------
+ * The constructor initializes a new shared occurrence of exp whose
+ * value is kept in the given temporary slot.  If owner is true, the
+ * node frees exp when it is deleted.
+ */
+
+    SharedExp(int slot, Expression *exp, bool owner);
+
+/*
+ * Prototypes for the virtual methods
+ * ----------------------------------
+ * These methods have the same prototypes as those in the Expression
+ * base class and don't require additional documentation.
+ */
+
+    virtual ~SharedExp();
+
+    virtual int eval(EvalState &state);
+
+    virtual std::string toString();
+
+    virtual ExpressionType getType();
+
+/*
+ * Methods: getSlot, getExp, isOwner
+ * Usage: int slot = ((SharedExp *) exp)->getSlot();
+ *        Expression *inner = ((SharedExp *) exp)->getExp();
+ *        if (((SharedExp *) exp)->isOwner()) . . .
+ * ------------------------------------------------------
+ * These methods return the temporary slot, the shared expression and
+ * whether this occurrence owns it, and can be applied only to an
+ * object known to be a SharedExp.
+ */
+
+    int getSlot();
+
+    Expression *getExp();
+
+    bool isOwner();
+
+private:
+
+    int slot;
+    Expression *exp;
+    bool owner;
+
+};
+
+/*
+ * Class: HoistedExp
+ * -----------------
+ * This subclass wraps a subexpression whose operands are not assigned
+ * anywhere in the body of an enclosing loop.  Its value is computed
+ * the first time it is needed after control enters the loop and is
+ * reused on every later iteration, which has the effect of moving the
+ * computation into the loop preheader without evaluating it on paths
+ * that would never have reached it.
+ */
+
+class HoistedExp : public Expression {
+
+public:
+
+/*
+ * Constructor: HoistedExp
+ * Usage: Expression *exp = new HoistedExp(loop, slot, exp);
+ * ---------------------------------------------------------
+ * The constructor initializes a new invariant expression of the given
+ * loop whose value is kept in the given slot.  The node owns exp.
+ */
+
+    HoistedExp(int loop, int slot, Expression *exp);
+
+/*
+ * Prototypes for the virtual methods
+ * ----------------------------------
+ * These methods have the same prototypes as those in the Expression
+ * base class and don't require additional documentation.
+ */
+
+    virtual ~HoistedExp();
+
+    virtual int eval(EvalState &state);
+
+    virtual std::string toString();
+
+    virtual ExpressionType getType();
+
+/*
+ * Methods: getLoop, getSlot, getExp
+ * Usage: Expression *inner = ((HoistedExp *) exp)->getExp();
+ * ----------------------------------------------------------
+ * Return the loop, the slot and the invariant expression, and can be
+ * applied only to an object known to be a HoistedExp.
+ */
+
+    int getLoop();
+
+    int getSlot();
+
+    Expression *getExp();
+
+private:
+
+    int loop;
+    int slot;
+    Expression *exp;
+
+};
+
+/*
+ * Class: FlatExp
+ * --------------
+ * This subclass is the root of an expression whose nodes are stored in
+ * an ExpressionTable, which evaluates it without a virtual call per
+ * node.  Compiling a program replaces the roots of its statements by
+ * FlatExp nodes and frees the trees they came from.
+ */
+
+class FlatExp : public Expression {
+
+public:
+
+/*
+ * Constructor: FlatExp
+ * Usage: Expression *exp = new FlatExp(table, node);
+ * --------------------------------------------------
+ * The constructor initializes a new root for the given node of table,
+ * which must outlive it.
+ */
+
+    FlatExp(const ExpressionTable &table, int node);
+
+/*
+ * Prototypes for the virtual methods
+ * ----------------------------------
+ * These methods have the same prototypes as those in the Expression
+ * base class and don't require additional documentation.
+ */
+
+    virtual int eval(EvalState &state);
+
+    virtual std::string toString();
+
+    virtual ExpressionType getType();
+
+/*
+ * Methods: getTable, getNode
+ * Usage: int node = ((FlatExp *) exp)->getNode();
+ * -----------------------------------------------
+ * Return the table and the node of the root, and can be applied only
+ * to an object known to be a FlatExp.
+ */
+
+    const ExpressionTable &getTable();
+
+    int getNode();
+
+private:
+
+    const ExpressionTable &table;
+    int node;
+
+};
+
+/*
+ * Class: PooledExp
+ * ----------------
+ * This subclass stands for one occurrence of an expression kept in an
+ * ExpressionPool, which holds a single copy of each distinct expression
+ * for all the lines of a program.  The expression must not be changed,
+ * since other lines may use it as well.
+ */
+
+class PooledExp : public Expression {
+
+public:
+
+/*
+ * Constructor: PooledExp
+ * Usage: Expression *exp = new PooledExp(pool, exp);
+ * --------------------------------------------------
+ * The constructor initializes a new occurrence of exp, which must have
+ * been returned by pool->intern, and takes over the reference that
+ * intern counted for it.
+ */
+
+    PooledExp(ExpressionPool *pool, Expression *exp);
+
+/*
+ * Prototypes for the virtual methods
+ * ----------------------------------
+ * These methods have the same prototypes as those in the Expression
+ * base class and don't require additional documentation.
+ */
+
+    virtual ~PooledExp();
+
+    virtual int eval(EvalState &state);
+
+    virtual std::string toString();
+
+    virtual ExpressionType getType();
+
+/*
+ * Method: getExp
+ * Usage: Expression *inner = ((PooledExp *) exp)->getExp();
+ * ---------------------------------------------------------
+ * Returns the expression in the pool, and can be applied only to an
+ * object known to be a PooledExp.
+ */
+
+    Expression *getExp();
+
+private:
+
+    ExpressionPool *pool;
+    Expression *exp;
+
+};
+
 #endif
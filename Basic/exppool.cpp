@@ -0,0 +1,163 @@
+/*
+ * File: exppool.cpp
+ * -----------------
+ * Implements the exppool.h interface.
+ */
+
+#include <functional>
+#include "exppool.hpp"
+#include "exp.hpp"
+#include "Utils/error.hpp"
+
+/*
+ * Implementation notes: the pool
+ * ------------------------------
+ * A compound expression in the pool points straight at the pooled
+ * expressions of its operands, so evaluating it costs no more than
+ * evaluating the tree it replaces; only the root goes through a
+ * PooledExp.  Since those operands belong to the pool and not to the
+ * compound expression, release detaches them before deleting it.  The
+ * key of a compound expression is its operator and the addresses of
+ * its operands, which identify their structure since the operands are
+ * themselves unique in the pool.
+ */
+
+ExpressionPool::ExpressionPool() = default;
+
+size_t ExpressionPool::KeyHash::operator()(const Key &key) const {
+    size_t hash = std::hash<intptr_t>()(key.first);
+    hash = hash * 31 + std::hash<intptr_t>()(key.second);
+    return hash * 31 + (unsigned char) key.kind;
+}
+
+ExpressionPool::Key ExpressionPool::keyOf(Expression *exp) {
+    switch (exp->getType()) {
+    case CONSTANT:
+        return Key{'c', ((ConstantExp *) exp)->getValue(), 0};
+    case IDENTIFIER:
+        return Key{'i', ((IdentifierExp *) exp)->getSymbol(), 0};
+    default: {
+        CompoundExp *compound = (CompoundExp *) exp;
+        return Key{compound->getOp()[0], (intptr_t) compound->getLHS(), (intptr_t) compound->getRHS()};
+    }
+    }
+}
+
+void ExpressionPool::share(const std::vector<Expression **> &roots) {
+    for (Expression **root : roots) {
+        bool pure;
+        *root = shareTree(*root, pure);
+        if (pure) *root = wrap(*root);
+    }
+}
+
+/*
+ * Implementation notes: shareTree
+ * -------------------------------
+ * The tree is walked bottom up, and a subtree is only pooled once its
+ * parent turns out not to be poolable, so each node is visited once
+ * and only the largest poolable subtrees become PooledExp nodes.
+ */
+
+Expression *ExpressionPool::shareTree(Expression *exp, bool &pure) {
+    pure = false;
+    switch (exp->getType()) {
+    case CONSTANT:
+    case IDENTIFIER:
+        pure = true;
+        return exp;
+    case COMPOUND: {
+        CompoundExp *compound = (CompoundExp *) exp;
+        bool left = false, right;
+        if (compound->getOp() != "=") compound->setLHS(shareTree(compound->getLHS(), left));
+        compound->setRHS(shareTree(compound->getRHS(), right));
+        if (left && right) {
+            pure = true;
+            return exp;
+        }
+        if (left) compound->setLHS(wrap(compound->getLHS()));
+        if (right) compound->setRHS(wrap(compound->getRHS()));
+        return exp;
+    }
+    case SHARED: {
+        SharedExp *shared = (SharedExp *) exp;
+        if (shared->isOwner() && shared->getExp()->getType() == COMPOUND) {
+            CompoundExp *compound = (CompoundExp *) shared->getExp();
+            bool left, right;
+            compound->setLHS(shareTree(compound->getLHS(), left));
+            compound->setRHS(shareTree(compound->getRHS(), right));
+            if (left) compound->setLHS(wrap(compound->getLHS()));
+            if (right) compound->setRHS(wrap(compound->getRHS()));
+        }
+        return exp;
+    }
+    default:
+        return exp;
+    }
+}
+
+Expression *ExpressionPool::wrap(Expression *exp) {
+    if (exp->getType() != COMPOUND) return exp;
+    Expression *canonical = intern(exp);
+    delete exp;
+    return new PooledExp(this, canonical);
+}
+
+Expression *ExpressionPool::intern(Expression *exp) {
+    Key key;
+    Expression *lhs = nullptr, *rhs = nullptr;
+    ExpressionType type = exp->getType();
+    if (type == CONSTANT || type == IDENTIFIER) {
+        key = keyOf(exp);
+    }
+    else if (type == COMPOUND) {
+        CompoundExp *compound = (CompoundExp *) exp;
+        lhs = intern(compound->getLHS());
+        rhs = intern(compound->getRHS());
+        key = Key{compound->getOp()[0], (intptr_t) lhs, (intptr_t) rhs};
+    }
+    else {
+        error("INTERNAL ERROR");
+    }
+    auto iter = index_.find(key);
+    if (iter != index_.end()) {
+        if (lhs != nullptr) {
+            release(lhs);
+            release(rhs);
+        }
+        ++(*iter).second.refs;
+        return (*iter).second.exp;
+    }
+    Expression *canonical;
+    if (type == CONSTANT) canonical = new ConstantExp(((ConstantExp *) exp)->getValue());
+    else if (type == IDENTIFIER) canonical = new IdentifierExp(((IdentifierExp *) exp)->getName());
+    else canonical = new CompoundExp(((CompoundExp *) exp)->getOp(), lhs, rhs);
+    index_[key] = Entry{canonical, 1};
+    return canonical;
+}
+
+void ExpressionPool::release(Expression *exp) {
+    auto iter = index_.find(keyOf(exp));
+    if (--(*iter).second.refs > 0) return;
+    index_.erase(iter);
+    if (exp->getType() == COMPOUND) {
+        CompoundExp *compound = (CompoundExp *) exp;
+        Expression *lhs = compound->getLHS();
+        Expression *rhs = compound->getRHS();
+        compound->setLHS(nullptr);
+        compound->setRHS(nullptr);
+        delete exp;
+        release(lhs);
+        release(rhs);
+        return;
+    }
+    delete exp;
+}
+
+void ExpressionPool::measure(MemoryStats &stats) const {
+    stats.expressions += hashBytes(index_.size(), index_.bucket_count(), sizeof(std::pair<const Key, Entry>));
+    for (auto iter = index_.begin(); iter != index_.end(); ++iter) {
+        char kind = (*iter).first.kind;
+        stats.expressions += kind == 'c' ? sizeof(ConstantExp) : kind == 'i' ? sizeof(IdentifierExp) : sizeof(CompoundExp);
+    }
+}
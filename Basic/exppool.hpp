@@ -0,0 +1,122 @@
+/*
+ * File: exppool.h
+ * ---------------
+ * This interface exports the ExpressionPool class, which keeps a single
+ * copy of each distinct expression used by the lines of a program.
+ */
+
+#ifndef _exppool_h
+#define _exppool_h
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "memory.hpp"
+
+class Expression;
+
+/*
+ * Class: ExpressionPool
+ * ---------------------
+ * An ExpressionPool hash-conses expressions made only of constants,
+ * variables and arithmetic operators: two such expressions with the
+ * same structure are the same object in the pool, and so are their
+ * equal parts.  Each expression in the pool counts the references to
+ * it, from the lines that use it and from the larger expressions it is
+ * part of, and is freed with its last reference.  Expressions in the
+ * pool are never changed.
+ */
+
+class ExpressionPool {
+
+public:
+
+/*
+ * Constructor: ExpressionPool
+ * Usage: ExpressionPool pool;
+ * ---------------------------
+ * Creates an empty pool.  The pool must outlive every PooledExp that
+ * refers to it.
+ */
+
+    ExpressionPool();
+
+    ExpressionPool(const ExpressionPool &) = delete;
+    ExpressionPool &operator=(const ExpressionPool &) = delete;
+
+/*
+ * Method: share
+ * Usage: pool.share(stmt->getExpressions());
+ * ------------------------------------------
+ * Replaces, in the expression trees rooted at roots, every largest
+ * subtree without assignments and made only of constants, variables
+ * and operators by a PooledExp for the same expression in the pool,
+ * and frees the subtree.  Lone constants and variables are left as
+ * they are, since a PooledExp is no smaller.  The parts of a shared
+ * subexpression are pooled, but not the subexpression itself, which
+ * the other occurrences refer to.
+ */
+
+    void share(const std::vector<Expression **> &roots);
+
+/*
+ * Methods: intern, release
+ * Usage: Expression *canonical = pool.intern(exp);
+ *        pool.release(canonical);
+ * ------------------------------------------------
+ * intern returns the expression in the pool with the structure of exp,
+ * adding it if there is none, and counts a reference to it; exp itself
+ * is left alone.  release gives a reference back.
+ */
+
+    Expression *intern(Expression *exp);
+
+    void release(Expression *exp);
+
+/*
+ * Method: measure
+ * Usage: pool.measure(stats);
+ * ---------------------------
+ * Adds the bytes used by the expressions in the pool and by its index
+ * to the expressions of stats.
+ */
+
+    void measure(MemoryStats &stats) const;
+
+private:
+
+    //节点的结构：常量为('c', 值)，变量为('i', 符号)，运算为(运算符, 左右两个池中节点)。
+    struct Key {
+        char kind;
+        intptr_t first;
+        intptr_t second;
+
+        bool operator==(const Key &other) const {
+            return kind == other.kind && first == other.first && second == other.second;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const;
+    };
+
+    struct Entry {
+        Expression *exp;
+        int refs;
+    };
+
+    std::unordered_map<Key, Entry, KeyHash> index_;
+
+    //池中节点的结构。
+    static Key keyOf(Expression *exp);
+
+    //在exp的子树中共享可共享的部分；exp整体可共享时置pure为true，交由调用者处理。
+    Expression *shareTree(Expression *exp, bool &pure);
+
+    //把可共享的exp换成PooledExp，常量与变量原样返回。
+    Expression *wrap(Expression *exp);
+
+};
+
+#endif
@@ -0,0 +1,172 @@
+/*
+ * File: exptable.cpp
+ * ------------------
+ * Implements the exptable.h interface.
+ */
+
+#include "exptable.hpp"
+#include "exp.hpp"
+#include "memory.hpp"
+#include "symbols.hpp"
+#include "Utils/error.hpp"
+#include "Utils/strlib.hpp"
+
+int ExpressionTable::push(NodeKind kind, int first, int second) {
+    kinds_.push_back(kind);
+    first_.push_back(first);
+    second_.push_back(second);
+    return (int) kinds_.size() - 1;
+}
+
+int ExpressionTable::add(Expression *exp) {
+    auto iter = added_.find(exp);
+    if (iter != added_.end()) return (*iter).second;
+    int node = -1;
+    switch (exp->getType()) {
+    case CONSTANT:
+        node = push(NODE_CONSTANT, ((ConstantExp *) exp)->getValue(), 0);
+        break;
+    case IDENTIFIER:
+        node = push(NODE_VARIABLE, ((IdentifierExp *) exp)->getSymbol(), 0);
+        break;
+    case COMPOUND: {
+        CompoundExp *compound = (CompoundExp *) exp;
+        std::string op = compound->getOp();
+        if (op == "=") {
+            int value = add(compound->getRHS());
+            node = push(NODE_ASSIGN, ((IdentifierExp *) compound->getLHS())->getSymbol(), value);
+            break;
+        }
+        int lhs = add(compound->getLHS());
+        int rhs = add(compound->getRHS());
+        NodeKind kind = op == "+" ? NODE_ADD : op == "-" ? NODE_SUBTRACT : op == "*" ? NODE_MULTIPLY : NODE_DIVIDE;
+        node = push(kind, lhs, rhs);
+        break;
+    }
+    case SHARED: {
+        SharedExp *shared = (SharedExp *) exp;
+        node = push(NODE_SHARED, shared->getSlot(), add(shared->getExp()));
+        break;
+    }
+    case HOISTED: {
+        HoistedExp *hoisted = (HoistedExp *) exp;
+        int slot = hoisted->getSlot();
+        node = push(NODE_HOISTED, slot, add(hoisted->getExp()));
+        if (slot >= (int) loops_.size()) loops_.resize(slot + 1, -1);
+        loops_[slot] = hoisted->getLoop();
+        break;
+    }
+    case POOLED:
+        node = add(((PooledExp *) exp)->getExp());
+        break;
+    case FLAT:
+        error("INTERNAL ERROR");
+    }
+    added_[exp] = node;
+    return node;
+}
+
+void ExpressionTable::finish() {
+    added_.clear();
+    kinds_.shrink_to_fit();
+    first_.shrink_to_fit();
+    second_.shrink_to_fit();
+    loops_.shrink_to_fit();
+}
+
+/*
+ * Implementation notes: eval
+ * --------------------------
+ * Operands are evaluated left before right into local variables, since
+ * the order of the calls in a single expression is unspecified and the
+ * errors must come in the order the trees report them.  The arithmetic
+ * wraps around exactly as CompoundExp::eval does.
+ */
+
+int ExpressionTable::eval(int node, EvalState &state) const {
+    int first = first_[node];
+    int second = second_[node];
+    switch (kinds_[node]) {
+    case NODE_CONSTANT:
+        return first;
+    case NODE_VARIABLE:
+        if (!state.isDefined(first)) error("VARIABLE NOT DEFINED");
+        return state.getValue(first);
+    case NODE_ASSIGN: {
+        int value = eval(second, state);
+        state.setValue(first, value);
+        return value;
+    }
+    case NODE_SHARED: {
+        int value;
+        if (state.lookupTemporary(first, value)) return value;
+        value = eval(second, state);
+        state.setTemporary(first, value);
+        return value;
+    }
+    case NODE_HOISTED: {
+        int value;
+        if (state.lookupInvariant(loops_[first], first, value)) return value;
+        value = eval(second, state);
+        state.setInvariant(loops_[first], first, value);
+        return value;
+    }
+    default:
+        break;
+    }
+    int left = eval(first, state);
+    int right = eval(second, state);
+    switch (kinds_[node]) {
+    case NODE_ADD:
+        return (int) ((unsigned) left + (unsigned) right);
+    case NODE_SUBTRACT:
+        return (int) ((unsigned) left - (unsigned) right);
+    case NODE_MULTIPLY:
+        return (int) ((unsigned) left * (unsigned) right);
+    default:
+        if (right == 0) error("DIVIDE BY ZERO");
+        if (right == -1) return (int) (0u - (unsigned) left);
+        return left / right;
+    }
+}
+
+std::string ExpressionTable::toString(int node) const {
+    static const char *const OPERATORS[] = {"", "", "=", "+", "-", "*", "/"};
+    switch (kinds_[node]) {
+    case NODE_CONSTANT:
+        return integerToString(first_[node]);
+    case NODE_VARIABLE:
+        return getSymbolName(first_[node]);
+    case NODE_ASSIGN:
+        return '(' + getSymbolName(first_[node]) + " = " + toString(second_[node]) + ')';
+    case NODE_SHARED:
+    case NODE_HOISTED:
+        return toString(second_[node]);
+    default:
+        return '(' + toString(first_[node]) + ' ' + OPERATORS[kinds_[node]] + ' ' + toString(second_[node]) + ')';
+    }
+}
+
+ExpressionTable::NodeKind ExpressionTable::getKind(int node) const {
+    return kinds_[node];
+}
+
+int ExpressionTable::getFirst(int node) const {
+    return first_[node];
+}
+
+int ExpressionTable::getSecond(int node) const {
+    return second_[node];
+}
+
+int ExpressionTable::getLoop(int node) const {
+    return loops_[first_[node]];
+}
+
+int ExpressionTable::size() const {
+    return (int) kinds_.size();
+}
+
+size_t ExpressionTable::getBytes() const {
+    return vectorBytes(kinds_) + vectorBytes(first_) + vectorBytes(second_) + vectorBytes(loops_);
+}
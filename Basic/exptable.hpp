@@ -0,0 +1,133 @@
+/*
+ * File: exptable.h
+ * ----------------
+ * This interface exports the ExpressionTable class, a compact form of
+ * the expressions of a compiled program.
+ */
+
+#ifndef _exptable_h
+#define _exptable_h
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "evalstate.hpp"
+
+class Expression;
+
+/*
+ * Class: ExpressionTable
+ * ----------------------
+ * An ExpressionTable holds the nodes of many expressions in parallel
+ * arrays instead of as separate objects.  A node is an index into the
+ * arrays: a kind byte and two 32-bit fields, which hold an immediate
+ * value, a symbol, a slot or the indices of the operands, depending on
+ * the kind.  The nodes of an expression are added after its operands,
+ * so an expression and its operands lie close together, and evaluation
+ * is a switch on the kind instead of a virtual call per node.
+ */
+
+class ExpressionTable {
+
+public:
+
+/*
+ * Type: NodeKind
+ * --------------
+ * The kinds of nodes and the meaning of their fields:
+ *
+ *   NODE_CONSTANT  the value
+ *   NODE_VARIABLE  the symbol of the variable
+ *   NODE_ASSIGN    the symbol of the variable, the value assigned
+ *   NODE_ADD, NODE_SUBTRACT, NODE_MULTIPLY, NODE_DIVIDE
+ *                  the left and right operands
+ *   NODE_SHARED    the temporary slot, the shared expression
+ *   NODE_HOISTED   the invariant slot, the invariant expression
+ */
+
+    enum NodeKind : uint8_t {
+        NODE_CONSTANT, NODE_VARIABLE, NODE_ASSIGN, NODE_ADD, NODE_SUBTRACT,
+        NODE_MULTIPLY, NODE_DIVIDE, NODE_SHARED, NODE_HOISTED
+    };
+
+/*
+ * Method: add
+ * Usage: int node = table.add(exp);
+ * ---------------------------------
+ * Adds the nodes of the expression tree exp and returns the node of its
+ * root.  A tree, or a part of it, that has been added before is not
+ * added again, so occurrences of a SharedExp all refer to the same
+ * nodes.  The tree is left unchanged, and it must stay alive until
+ * finish is called.
+ */
+
+    int add(Expression *exp);
+
+/*
+ * Method: finish
+ * Usage: table.finish();
+ * ----------------------
+ * Ends the adding of expressions, after which the trees that were added
+ * may be freed.
+ */
+
+    void finish();
+
+/*
+ * Method: eval
+ * Usage: int value = table.eval(node, state);
+ * -------------------------------------------
+ * Evaluates the expression with root node, with the same result,
+ * effects and errors as the tree it was added from.
+ */
+
+    int eval(int node, EvalState &state) const;
+
+/*
+ * Method: toString
+ * Usage: std::string text = table.toString(node);
+ * -----------------------------------------------
+ * Returns the same text as the toString method of the tree the node
+ * was added from.
+ */
+
+    std::string toString(int node) const;
+
+/*
+ * Methods: getKind, getFirst, getSecond, getLoop, size
+ * Usage: ExpressionTable::NodeKind kind = table.getKind(node);
+ * ------------------------------------------------------------
+ * Return the kind and the fields of a node, the loop of the slot of a
+ * NODE_HOISTED node and the number of nodes in the table.
+ */
+
+    NodeKind getKind(int node) const;
+    int getFirst(int node) const;
+    int getSecond(int node) const;
+    int getLoop(int node) const;
+    int size() const;
+
+/*
+ * Method: getBytes
+ * Usage: size_t bytes = table.getBytes();
+ * ---------------------------------------
+ * Returns the bytes of heap memory used by the nodes of the table.
+ */
+
+    size_t getBytes() const;
+
+private:
+    std::vector<NodeKind> kinds_;
+    std::vector<int32_t> first_;
+    std::vector<int32_t> second_;
+    //循环不变量的槽->所属循环。
+    std::vector<int32_t> loops_;
+    //构建期间已加入的树节点->编号。
+    std::unordered_map<Expression *, int> added_;
+
+    int push(NodeKind kind, int first, int second);
+
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * File: files.cpp
+ * ---------------
+ * Implements the files.h interface.
+ */
+
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include "files.hpp"
+
+uint32_t hashFNV32(const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *) data;
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+uint64_t hashFNV64(const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *) data;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*
+ * Implementation notes: replaceFile
+ * ---------------------------------
+ * The name of the new file includes the process and the thread, so
+ * that writers of the same path never share one, and whoever renames
+ * last wins.
+ */
+
+bool replaceFile(const std::string &path, const std::string &data, int *fd) {
+    std::ostringstream name;
+    name << path << '.' << getpid() << '.' << std::this_thread::get_id();
+    std::string temporary = name.str();
+    int out = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) return false;
+    const char *p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        ssize_t written = write(out, p, left);
+        if (written <= 0) break;
+        p += written;
+        left -= written;
+    }
+    if (left > 0 || fsync(out) != 0 || rename(temporary.c_str(), path.c_str()) != 0) {
+        close(out);
+        unlink(temporary.c_str());
+        return false;
+    }
+    if (fd != nullptr) *fd = out;
+    else close(out);
+    return true;
+}
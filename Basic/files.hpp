@@ -0,0 +1,45 @@
+/*
+ * File: files.h
+ * -------------
+ * This interface exports the helpers shared by the modules that keep
+ * data in files of their own: the image cache, the variable store and
+ * the edit journal.
+ */
+
+#ifndef _files_h
+#define _files_h
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Functions: hashFNV32, hashFNV64
+ * Usage: uint64_t hash = hashFNV64(data, size);
+ * ---------------------------------------------
+ * Return the 32-bit and 64-bit FNV-1a hash of size bytes at data.  The
+ * values are part of the file formats that use them and must never
+ * change.
+ */
+
+uint32_t hashFNV32(const void *data, size_t size);
+
+uint64_t hashFNV64(const void *data, size_t size);
+
+/*
+ * Function: replaceFile
+ * Usage: if (replaceFile(path, data)) . . .
+ *        if (replaceFile(path, data, &fd)) . . .
+ * ----------------------------------------------
+ * Replaces the contents of the file at path with data, so that other
+ * processes, and the file after a crash, show either the old contents
+ * or the new ones but nothing in between.  The data is written to a
+ * file of its own beside path, flushed to disk and renamed over path.
+ * Returns false, leaving path as it was, if any step fails.  The second
+ * form also stores in fd a descriptor of the new file, open for reading
+ * and writing, which the caller must close.
+ */
+
+bool replaceFile(const std::string &path, const std::string &data, int *fd = nullptr);
+
+#endif
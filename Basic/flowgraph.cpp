@@ -0,0 +1,259 @@
+/*
+ * File: flowgraph.cpp
+ * -------------------
+ * Implements the flowgraph.h interface.
+ */
+
+#include <algorithm>
+#include <map>
+#include "flowgraph.hpp"
+#include "compiled.hpp"
+#include "memory.hpp"
+#include "statement.hpp"
+
+FlowGraph::FlowGraph() = default;
+
+void FlowGraph::build(const CompiledProgram &program) {
+    lines.clear();
+    index.clear();
+    loops.clear();
+    headers.clear();
+    for (int line = program.getFirstLineNumber(); line != -1; line = program.getNextLineNumber(line)) {
+        index[line] = (int) lines.size();
+        lines.push_back(line);
+    }
+    successors.assign(lines.size(), std::vector<int>());
+    predecessors.assign(lines.size(), std::vector<int>());
+    for (int node = 0; node < (int) lines.size(); ++node) {
+        addEdges(program, node);
+    }
+    computeDominators();
+
+/*
+ * Every edge whose target dominates its source closes a loop.  The body
+ * is found by walking backwards from the source of the edge until the
+ * header is reached.
+ */
+
+    std::map<int, std::vector<bool>> bodies;
+    for (int node = 0; node < (int) lines.size(); ++node) {
+        for (int target : successors[node]) {
+            if (!dominates(target, node)) continue;
+            std::vector<bool> &inBody = bodies[target];
+            if (inBody.empty()) {
+                inBody.assign(lines.size(), false);
+                inBody[target] = true;
+            }
+            std::vector<int> work;
+            if (!inBody[node]) {
+                inBody[node] = true;
+                work.push_back(node);
+            }
+            while (!work.empty()) {
+                int current = work.back();
+                work.pop_back();
+                for (int previous : predecessors[current]) {
+                    if (!inBody[previous] && dominator[previous] != -1) {
+                        inBody[previous] = true;
+                        work.push_back(previous);
+                    }
+                }
+            }
+        }
+    }
+    for (auto &entry : bodies) {
+        Loop loop;
+        loop.header = lines[entry.first];
+        for (int node = 0; node < (int) lines.size(); ++node) {
+            if (entry.second[node]) {
+                loop.body.push_back(lines[node]);
+                loop.members.insert(lines[node]);
+            }
+        }
+        loops.push_back(loop);
+    }
+    std::stable_sort(loops.begin(), loops.end(), [](const Loop &a, const Loop &b) {
+        return a.body.size() > b.body.size();
+    });
+    for (int loop = 0; loop < (int) loops.size(); ++loop) {
+        headers[loops[loop].header] = loop;
+    }
+}
+
+int FlowGraph::countLoops() const {
+    return (int) loops.size();
+}
+
+int FlowGraph::getLoopHeader(int loop) const {
+    return loops[loop].header;
+}
+
+const std::vector<int> &FlowGraph::getLoopBody(int loop) const {
+    return loops[loop].body;
+}
+
+int FlowGraph::findLoop(int lineNumber) const {
+    auto iter = headers.find(lineNumber);
+    return iter == headers.end() ? -1 : iter->second;
+}
+
+bool FlowGraph::inLoop(int loop, int lineNumber) const {
+    return loops[loop].members.count(lineNumber) != 0;
+}
+
+bool FlowGraph::isReachable(int lineNumber) const {
+    auto iter = index.find(lineNumber);
+    return iter != index.end() && dominator[iter->second] != -1;
+}
+
+size_t FlowGraph::getBytes() const {
+    size_t bytes = vectorBytes(lines) + vectorBytes(successors) + vectorBytes(predecessors) + vectorBytes(dominator)
+                   + vectorBytes(enter) + vectorBytes(leave) + vectorBytes(loops);
+    bytes += hashBytes(index.size(), index.bucket_count(), sizeof(std::pair<const int, int>));
+    bytes += hashBytes(headers.size(), headers.bucket_count(), sizeof(std::pair<const int, int>));
+    for (size_t node = 0; node < successors.size(); ++node) {
+        bytes += vectorBytes(successors[node]) + vectorBytes(predecessors[node]);
+    }
+    for (const Loop &loop : loops) {
+        bytes += vectorBytes(loop.body) + hashBytes(loop.members.size(), loop.members.bucket_count(), sizeof(int));
+    }
+    return bytes;
+}
+
+/*
+ * Implementation notes: addEdges
+ * ------------------------------
+ * The edges mirror Program::run_program_, which moves to the next line
+ * whenever a statement leaves the program counter unchanged.
+ */
+
+void FlowGraph::addEdges(const CompiledProgram &program, int node) {
+    Statement *stmt = program.getParsedStatement(lines[node]);
+    int next = node + 1 < (int) lines.size() ? node + 1 : -1;
+    bool fallsThrough = true;
+    int target = -1;
+    switch (stmt->getType()) {
+    case GOTO_STMT:
+        fallsThrough = false;
+        target = ((Control *) stmt)->getTarget();
+        break;
+    case IF_STMT:
+    case PARALLEL_STMT:
+        target = ((Control *) stmt)->getTarget();
+        break;
+    case END_STMT:
+        fallsThrough = false;
+        break;
+    default:
+        break;
+    }
+    std::vector<int> targets;
+    if (target != -1) {
+        auto iter = index.find(target);
+        if (iter != index.end()) {
+            if (iter->second == node) fallsThrough = true;
+            else targets.push_back(iter->second);
+        }
+    }
+    if (fallsThrough && next != -1) targets.push_back(next);
+    for (int to : targets) {
+        if (std::find(successors[node].begin(), successors[node].end(), to) != successors[node].end()) continue;
+        successors[node].push_back(to);
+        predecessors[to].push_back(node);
+    }
+}
+
+/*
+ * Implementation notes: computeDominators
+ * ---------------------------------------
+ * This is the iterative algorithm of Cooper, Harvey and Kennedy.  The
+ * nodes are numbered in reverse postorder from the first line, and the
+ * immediate dominators are refined until they stop changing.  Lines
+ * that cannot be reached keep -1 as their dominator.  A walk of the
+ * resulting tree then numbers the nodes in preorder, so that a node
+ * dominates exactly the nodes numbered from its own number up to the
+ * largest number in its subtree, and dominates is a constant-time test
+ * even when the tree is as deep as the program is long.
+ */
+
+void FlowGraph::computeDominators() {
+    int count = (int) lines.size();
+    dominator.assign(count, -1);
+    if (count == 0) return;
+    std::vector<int> postorder;
+    std::vector<int> order(count, -1);
+    std::vector<bool> visited(count, false);
+    std::vector<std::pair<int, int>> stack;
+    stack.emplace_back(0, 0);
+    visited[0] = true;
+    while (!stack.empty()) {
+        int node = stack.back().first;
+        int &edge = stack.back().second;
+        if (edge < (int) successors[node].size()) {
+            int next = successors[node][edge++];
+            if (!visited[next]) {
+                visited[next] = true;
+                stack.emplace_back(next, 0);
+            }
+        }
+        else {
+            order[node] = (int) postorder.size();
+            postorder.push_back(node);
+            stack.pop_back();
+        }
+    }
+    dominator[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = (int) postorder.size() - 2; i >= 0; --i) {
+            int node = postorder[i];
+            int idom = -1;
+            for (int previous : predecessors[node]) {
+                if (dominator[previous] == -1) continue;
+                if (idom == -1) {
+                    idom = previous;
+                    continue;
+                }
+                int a = previous, b = idom;
+                while (a != b) {
+                    while (order[a] < order[b]) a = dominator[a];
+                    while (order[b] < order[a]) b = dominator[b];
+                }
+                idom = a;
+            }
+            if (idom != dominator[node]) {
+                dominator[node] = idom;
+                changed = true;
+            }
+        }
+    }
+    std::vector<std::vector<int>> children(count);
+    for (int node = 1; node < count; ++node) {
+        if (dominator[node] != -1) children[dominator[node]].push_back(node);
+    }
+    enter.assign(count, -1);
+    leave.assign(count, -1);
+    int number = 0;
+    std::vector<std::pair<int, int>> walk;
+    walk.emplace_back(0, 0);
+    enter[0] = number++;
+    while (!walk.empty()) {
+        int node = walk.back().first;
+        int &child = walk.back().second;
+        if (child < (int) children[node].size()) {
+            int next = children[node][child++];
+            enter[next] = number++;
+            walk.emplace_back(next, 0);
+        }
+        else {
+            leave[node] = number - 1;
+            walk.pop_back();
+        }
+    }
+}
+
+bool FlowGraph::dominates(int a, int b) const {
+    if (dominator[a] == -1 || dominator[b] == -1) return false;
+    return enter[a] <= enter[b] && enter[b] <= leave[a];
+}
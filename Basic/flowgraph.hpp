@@ -0,0 +1,144 @@
+/*
+ * File: flowgraph.h
+ * -----------------
+ * This interface exports the FlowGraph class, a line-level view of the
+ * control flow of a BASIC program together with the natural loops
+ * formed by its backward IF and GOTO jumps.
+ */
+
+#ifndef _flowgraph_h
+#define _flowgraph_h
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+class CompiledProgram;
+
+/*
+ * Class: FlowGraph
+ * ----------------
+ * Each program line is a node of the graph.  A line has an edge to
+ * the line that follows it unless it is a GOTO or an END, and IF and
+ * GOTO lines have an edge to their target.  A PARALLEL FOR line has an
+ * edge to its body and one to its NEXT line.  A jump to a line that does
+ * not exist has no edge, since executing it stops the program.  A
+ * jump from a line to itself continues with the following line, which
+ * is what Program::run_program_ does with it.
+ *
+ * A loop is identified by its header, the line every iteration
+ * passes through; loops that share a header are merged.
+ */
+
+class FlowGraph {
+
+public:
+
+/*
+ * Constructor: FlowGraph
+ * Usage: FlowGraph flow;
+ * ----------------------
+ * Constructs an empty graph with no loops.
+ */
+
+    FlowGraph();
+
+/*
+ * Method: build
+ * Usage: flow.build(program);
+ * ---------------------------
+ * Replaces the contents of the graph with the control flow of the
+ * specified program, computes the dominators of every line reachable
+ * from the first one and collects the natural loops.  Loops are
+ * numbered so that an enclosing loop comes before the loops nested
+ * inside it.
+ */
+
+    void build(const CompiledProgram &program);
+
+/*
+ * Method: countLoops
+ * Usage: int n = flow.countLoops();
+ * ---------------------------------
+ * Returns the number of loops found by the last call to build.
+ */
+
+    int countLoops() const;
+
+/*
+ * Methods: getLoopHeader, getLoopBody
+ * Usage: int header = flow.getLoopHeader(loop);
+ *        for (int line : flow.getLoopBody(loop)) . . .
+ * --------------------------------------------------
+ * Return the header line of a loop and the lines of its body, which
+ * include the header and are sorted by line number.
+ */
+
+    int getLoopHeader(int loop) const;
+
+    const std::vector<int> &getLoopBody(int loop) const;
+
+/*
+ * Method: findLoop
+ * Usage: int loop = flow.findLoop(lineNumber);
+ * --------------------------------------------
+ * Returns the loop whose header is the specified line, or -1 if the
+ * line is not a loop header.
+ */
+
+    int findLoop(int lineNumber) const;
+
+/*
+ * Method: inLoop
+ * Usage: if (flow.inLoop(loop, lineNumber)) . . .
+ * -----------------------------------------------
+ * Returns true if the specified line belongs to the body of the loop.
+ */
+
+    bool inLoop(int loop, int lineNumber) const;
+
+/*
+ * Method: isReachable
+ * Usage: if (flow.isReachable(lineNumber)) . . .
+ * ----------------------------------------------
+ * Returns true if some path from the first line reaches the specified
+ * line.
+ */
+
+    bool isReachable(int lineNumber) const;
+
+/*
+ * Method: getBytes
+ * Usage: size_t bytes = flow.getBytes();
+ * --------------------------------------
+ * Returns the bytes of heap memory used by the graph.
+ */
+
+    size_t getBytes() const;
+
+private:
+
+    struct Loop {
+        int header;
+        std::vector<int> body;
+        std::unordered_set<int> members;
+    };
+
+    std::vector<int> lines;
+    std::unordered_map<int, int> index;
+    std::vector<std::vector<int>> successors;
+    std::vector<std::vector<int>> predecessors;
+    std::vector<int> dominator;
+    //支配树的先序编号与其子树中最大的先序编号。
+    std::vector<int> enter;
+    std::vector<int> leave;
+    std::vector<Loop> loops;
+    std::unordered_map<int, int> headers;
+
+    void addEdges(const CompiledProgram &program, int node);
+    void computeDominators();
+    bool dominates(int a, int b) const;
+
+};
+
+#endif
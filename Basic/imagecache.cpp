@@ -0,0 +1,383 @@
+/*
+ * File: imagecache.cpp
+ * --------------------
+ * Implements the imagecache.h interface.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "imagecache.hpp"
+#include "exptable.hpp"
+#include "files.hpp"
+#include "statement.hpp"
+#include "symbols.hpp"
+#include "Utils/error.hpp"
+
+/*
+ * Implementation notes: image format
+ * ----------------------------------
+ * An image is a header, a table that gives for each line, in ascending
+ * order, its number and where its stored text and its code are, then
+ * the source of the program file, the text of all lines and then their
+ * code.  The code of a line is
+ * its statement flattened in prefix order: a type byte followed by the
+ * parts of the statement, where an expression is a kind byte followed
+ * by a value, a name, or an operator and its two operands.  Integers
+ * are four bytes in the byte order of the machine and strings carry
+ * their length in front.  Shared, hoisted and pooled subexpressions,
+ * and the expressions of a compiled program, are written out as trees
+ * in full, and sharing them again is left to the constructors and to
+ * the program, so the statements read back are those the parser would
+ * build.
+ *
+ * The file is named after a 64-bit FNV-1a hash of the source.  Since
+ * two sources may share a hash, the image keeps the source itself, and
+ * an image is only used if that is exactly the source being loaded.  Any change to the
+ * layout, to how lines are stored or to how statements are parsed must
+ * change the version.
+ */
+
+namespace {
+
+const char MAGIC[8] = {'B', 'A', 'S', 'I', 'M', 'A', 'G', 'E'};
+const uint32_t VERSION = 2;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t hash;
+    uint64_t size;
+    uint64_t text;
+    uint64_t code;
+};
+
+struct Entry {
+    int32_t number;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t start;
+    uint32_t bytes;
+};
+
+uint64_t hashSource(const std::string &source) {
+    return hashFNV64(source.data(), source.size());
+}
+
+void putInt(std::string &out, int32_t value) {
+    out.append((const char *) &value, sizeof(value));
+}
+
+void putString(std::string &out, const std::string &value) {
+    putInt(out, (int32_t) value.size());
+    out += value;
+}
+
+void putNode(std::string &out, const ExpressionTable &table, int node) {
+    static const char *const OPERATORS[] = {"", "", "", "+", "-", "*", "/"};
+    ExpressionTable::NodeKind kind = table.getKind(node);
+    switch (kind) {
+    case ExpressionTable::NODE_CONSTANT:
+        out += 'c';
+        putInt(out, table.getFirst(node));
+        break;
+    case ExpressionTable::NODE_VARIABLE:
+        out += 'i';
+        putString(out, getSymbolName(table.getFirst(node)));
+        break;
+    case ExpressionTable::NODE_ASSIGN:
+        out += 'o';
+        putString(out, "=");
+        out += 'i';
+        putString(out, getSymbolName(table.getFirst(node)));
+        putNode(out, table, table.getSecond(node));
+        break;
+    case ExpressionTable::NODE_SHARED:
+    case ExpressionTable::NODE_HOISTED:
+        putNode(out, table, table.getSecond(node));
+        break;
+    default:
+        out += 'o';
+        putString(out, OPERATORS[kind]);
+        putNode(out, table, table.getFirst(node));
+        putNode(out, table, table.getSecond(node));
+        break;
+    }
+}
+
+void putExp(std::string &out, Expression *exp) {
+    switch (exp->getType()) {
+    case CONSTANT:
+        out += 'c';
+        putInt(out, ((ConstantExp *) exp)->getValue());
+        break;
+    case IDENTIFIER:
+        out += 'i';
+        putString(out, ((IdentifierExp *) exp)->getName());
+        break;
+    case COMPOUND:
+        out += 'o';
+        putString(out, ((CompoundExp *) exp)->getOp());
+        putExp(out, ((CompoundExp *) exp)->getLHS());
+        putExp(out, ((CompoundExp *) exp)->getRHS());
+        break;
+    case SHARED:
+        putExp(out, ((SharedExp *) exp)->getExp());
+        break;
+    case HOISTED:
+        putExp(out, ((HoistedExp *) exp)->getExp());
+        break;
+    case FLAT:
+        putNode(out, ((FlatExp *) exp)->getTable(), ((FlatExp *) exp)->getNode());
+        break;
+    case POOLED:
+        putExp(out, ((PooledExp *) exp)->getExp());
+        break;
+    }
+}
+
+void putStatement(std::string &out, Statement *stmt) {
+    StatementType type = stmt->getType();
+    out += (char) type;
+    switch (type) {
+    case LET_STMT:
+    case PRINT_STMT:
+        putExp(out, *stmt->getExpressions()[0]);
+        break;
+    case INPUT_STMT:
+        putString(out, getSymbolName(((Sequential *) stmt)->getVariable()));
+        break;
+    case GOTO_STMT:
+        putInt(out, ((Control *) stmt)->getTarget());
+        break;
+    case IF_STMT:
+        putExp(out, ((IF *) stmt)->getLHS());
+        out += ((IF *) stmt)->getCompare();
+        putExp(out, ((IF *) stmt)->getRHS());
+        putInt(out, ((Control *) stmt)->getTarget());
+        break;
+    case PARALLEL_STMT: {
+        PARALLEL *loop = (PARALLEL *) stmt;
+        putString(out, getSymbolName(loop->getVariable()));
+        putExp(out, *loop->getExpressions()[0]);
+        putExp(out, *loop->getExpressions()[1]);
+        putInt(out, (int32_t) loop->getReductions().size());
+        for (auto &reduction : loop->getReductions()) {
+            out += reduction.first;
+            putString(out, getSymbolName(reduction.second));
+        }
+        break;
+    }
+    case NEXT_STMT:
+        putString(out, getSymbolName(((NEXT *) stmt)->getVariable()));
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Class: Reader
+ * -------------
+ * Reads the code of one line, raising an error instead of reading past
+ * its end.  Whatever it has built when that happens is freed.
+ */
+
+class Reader {
+public:
+    Reader(const char *start, const char *end) : p(start), end(end) {
+    }
+
+    bool atEnd() const {
+        return p == end;
+    }
+
+    char getByte() {
+        if (p == end) error("DAMAGED IMAGE");
+        return *p++;
+    }
+
+    int32_t getInt() {
+        int32_t value;
+        if (end - p < (long) sizeof(value)) error("DAMAGED IMAGE");
+        memcpy(&value, p, sizeof(value));
+        p += sizeof(value);
+        return value;
+    }
+
+    std::string getString() {
+        int32_t length = getInt();
+        if (length < 0 || end - p < length) error("DAMAGED IMAGE");
+        std::string value(p, length);
+        p += length;
+        return value;
+    }
+
+    std::unique_ptr<Expression> getExp() {
+        char kind = getByte();
+        if (kind == 'c') return std::unique_ptr<Expression>(new ConstantExp(getInt()));
+        if (kind == 'i') return std::unique_ptr<Expression>(new IdentifierExp(getString()));
+        if (kind != 'o') error("DAMAGED IMAGE");
+        std::string op = getString();
+        std::unique_ptr<Expression> lhs = getExp();
+        std::unique_ptr<Expression> rhs = getExp();
+        return std::unique_ptr<Expression>(new CompoundExp(op, lhs.release(), rhs.release()));
+    }
+
+    std::unique_ptr<Statement> getStatement() {
+        StatementType type = (StatementType) getByte();
+        switch (type) {
+        case REM_STMT:
+            return std::unique_ptr<Statement>(new Sequential(type, nullptr, -1));
+        case LET_STMT:
+        case PRINT_STMT:
+            return std::unique_ptr<Statement>(new Sequential(type, getExp().release(), -1));
+        case INPUT_STMT:
+            return std::unique_ptr<Statement>(new Sequential(type, nullptr, internSymbol(getString())));
+        case GOTO_STMT:
+            return std::unique_ptr<Statement>(new GOTO(getInt()));
+        case END_STMT:
+            return std::unique_ptr<Statement>(new END());
+        case IF_STMT: {
+            std::unique_ptr<Expression> lhs = getExp();
+            char compare = getByte();
+            std::unique_ptr<Expression> rhs = getExp();
+            int target = getInt();
+            return std::unique_ptr<Statement>(new IF(lhs.release(), compare, rhs.release(), target));
+        }
+        case PARALLEL_STMT: {
+            int variable = internSymbol(getString());
+            std::unique_ptr<Expression> from = getExp();
+            std::unique_ptr<Expression> to = getExp();
+            int32_t count = getInt();
+            if (count < 0 || count > end - p) error("DAMAGED IMAGE");
+            std::vector<std::pair<char, int>> reductions(count);
+            for (auto &reduction : reductions) {
+                reduction.first = getByte();
+                reduction.second = internSymbol(getString());
+            }
+            return std::unique_ptr<Statement>(new PARALLEL(variable, from.release(), to.release(), reductions));
+        }
+        case NEXT_STMT:
+            return std::unique_ptr<Statement>(new NEXT(internSymbol(getString())));
+        default:
+            error("DAMAGED IMAGE");
+            return nullptr;
+        }
+    }
+
+private:
+    const char *p;
+    const char *end;
+};
+
+std::string imagePath(const std::string &cache, uint64_t hash) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.img", (unsigned long long) hash);
+    return cache + "/" + name;
+}
+
+}
+
+bool loadCachedProgram(const std::string &cache, const std::string &source, Program &program) {
+    uint64_t hash = hashSource(source);
+    int fd = open(imagePath(cache, hash).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t) info.st_size < sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+    size_t size = info.st_size;
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+    const char *base = (const char *) mapped;
+    const Header *header = (const Header *) base;
+    const Entry *entries = (const Entry *) (base + sizeof(Header));
+    const char *saved = base + sizeof(Header) + header->count * sizeof(Entry);
+    const char *text = saved + header->size;
+    const char *code = text + header->text;
+    bool valid = memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 && header->version == VERSION
+                 && header->hash == hash && header->size == source.size()
+                 && sizeof(Header) + header->count * sizeof(Entry) + header->size + header->text + header->code == size
+                 && memcmp(saved, source.data(), source.size()) == 0;
+    for (uint32_t i = 0; valid && i < header->count; ++i) {
+        valid = (uint64_t) entries[i].offset + entries[i].length <= header->text
+                && (uint64_t) entries[i].start + entries[i].bytes <= header->code
+                && (i == 0 || entries[i - 1].number < entries[i].number);
+    }
+    std::vector<std::unique_ptr<Statement>> statements;
+    try {
+        for (uint32_t i = 0; valid && i < header->count; ++i) {
+            Reader reader(code + entries[i].start, code + entries[i].start + entries[i].bytes);
+            statements.push_back(reader.getStatement());
+            if (!reader.atEnd()) error("DAMAGED IMAGE");
+        }
+    }
+    catch (ErrorException &ex) {
+        valid = false;
+    }
+    if (valid) {
+        for (uint32_t i = 0; i < header->count; ++i) {
+            program.addSourceLine(entries[i].number, std::string(text + entries[i].offset, entries[i].length),
+                                  std::move(statements[i]));
+        }
+    }
+    munmap(mapped, size);
+    return valid;
+}
+
+/*
+ * Implementation notes: saveCachedProgram
+ * ---------------------------------------
+ * The image replaces the file through replaceFile, so that processes
+ * reading the cache at the same time only ever see complete images,
+ * whoever writes last.
+ */
+
+void saveCachedProgram(const std::string &cache, const std::string &source, Program &program) {
+    std::vector<Entry> entries;
+    std::string text, code;
+    for (int line = program.getFirstLineNumber(); line != -1; line = program.getNextLineNumber(line)) {
+        std::string stored = program.getSourceLine(line);
+        size_t start = code.size();
+        putStatement(code, program.getParsedStatement(line));
+        entries.push_back({line, (uint32_t) text.size(), (uint32_t) stored.size(),
+                           (uint32_t) start, (uint32_t) (code.size() - start)});
+        text += stored;
+    }
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.count = (uint32_t) entries.size();
+    header.hash = hashSource(source);
+    header.size = source.size();
+    header.text = text.size();
+    header.code = code.size();
+    std::string path = imagePath(cache, header.hash);
+    std::string image((const char *) &header, sizeof(header));
+    image.append((const char *) entries.data(), entries.size() * sizeof(Entry));
+    image += source;
+    image += text;
+    image += code;
+    replaceFile(path, image);
+}
+
+void writeStatement(std::string &out, Statement *stmt) {
+    putStatement(out, stmt);
+}
+
+std::unique_ptr<Statement> readStatement(const char *start, const char *end) {
+    Reader reader(start, end);
+    std::unique_ptr<Statement> stmt = reader.getStatement();
+    if (!reader.atEnd()) error("DAMAGED IMAGE");
+    return stmt;
+}
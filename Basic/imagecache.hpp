@@ -0,0 +1,59 @@
+/*
+ * File: imagecache.h
+ * ------------------
+ * This interface exports a cache of program images on disk, which lets
+ * a process load a program file it has seen before without processing
+ * its lines again.
+ */
+
+#ifndef _imagecache_h
+#define _imagecache_h
+
+#include <memory>
+#include <string>
+#include "program.hpp"
+
+/*
+ * Function: loadCachedProgram
+ * Usage: if (loadCachedProgram(cache, source, program)) . . .
+ * -----------------------------------------------------------
+ * Looks in the directory cache for the image saved for the exact text
+ * source of a program file.  If there is one, its lines are added to
+ * program as processLine would have stored them, and the function
+ * returns true.  The image is mapped into memory and read in place:
+ * the statements are rebuilt from their flattened form without any
+ * tokenizing or parsing.  A missing, damaged or outdated image is
+ * ignored, and the function returns false without touching program.
+ */
+
+bool loadCachedProgram(const std::string &cache, const std::string &source, Program &program);
+
+/*
+ * Function: saveCachedProgram
+ * Usage: saveCachedProgram(cache, source, program);
+ * -------------------------------------------------
+ * Saves the lines of program as the image for the file text source.
+ * The caller must only do so if processing the lines of source, in an
+ * empty program, produced exactly these lines and no output.  Errors
+ * while writing are ignored, since the cache can always be rebuilt.
+ */
+
+void saveCachedProgram(const std::string &cache, const std::string &source, Program &program);
+
+/*
+ * Functions: writeStatement, readStatement
+ * Usage: writeStatement(out, stmt);
+ *        std::unique_ptr<Statement> stmt = readStatement(start, end);
+ * -----------------------------------------------------------------
+ * Convert between a statement and the flattened form of the code of a
+ * line in an image.  writeStatement appends the code of stmt to out;
+ * readStatement builds the statement back from the bytes between start
+ * and end, without tokenizing or parsing, and raises an error if they
+ * are not exactly the code of one statement.
+ */
+
+void writeStatement(std::string &out, Statement *stmt);
+
+std::unique_ptr<Statement> readStatement(const char *start, const char *end);
+
+#endif
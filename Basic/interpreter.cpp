@@ -0,0 +1,135 @@
+/*
+ * File: interpreter.cpp
+ * ---------------------
+ * This file implements the interpreter.h interface, which reads the
+ * lines typed by the user and either stores them in the program or
+ * executes them immediately.
+ */
+
+#include <cctype>
+#include <iostream>
+#include <string>
+#include <utility>
+#include "interpreter.hpp"
+#include "exp.hpp"
+#include "parser.hpp"
+#include "Utils/error.hpp"
+#include "Utils/tokenScanner.hpp"
+#include "Utils/strlib.hpp"
+
+/*
+ * Implementation notes: processLine
+ * ---------------------------------
+ * The first token decides between a program line and a command.  The
+ * text of a program line is normalized to its tokens separated by
+ * spaces before it is parsed, and that text is what LIST prints.
+ */
+
+void processLine(std::string line, Program &program, EvalState &state) {
+    TokenScanner scanner;
+    scanner.ignoreWhitespace();
+    scanner.scanNumbers();
+    scanner.setInput(line);
+    std::string next = scanner.nextToken();
+    TokenType type = scanner.getTokenType(next);
+    switch (type) {
+    case NUMBER: {
+        int number = stringToInteger(next);
+        if(!scanner.hasMoreTokens()){
+            program.removeSourceLine(number);
+            return;
+        }
+        std::string say;
+        tokenToString(scanner, say);
+        storeLine(program, number, say, parseStatement(say));
+        break;
+    }
+    case WORD: {
+        if(next=="QUIT"){
+            state.requestQuit();
+        }
+        else if(next=="HELP"){
+            state.getOutput()<<"???";
+        }
+        else if(next=="LET"){
+            scanner.saveToken(next);
+            Sequential statement_1(scanner);
+            statement_1.validate();
+            statement_1.execute(state,program);
+        }
+        else if(next=="PRINT"){
+            scanner.saveToken(next);
+            Sequential statement_1(scanner);
+            statement_1.validate();
+            statement_1.execute(state,program);
+        }
+        else if(next=="INPUT"){
+            scanner.saveToken(next);
+            Sequential statement_1(scanner);
+            statement_1.validate();
+            statement_1.execute(state,program);
+        }
+        else if(next=="RUN"||next=="LIST"||next=="CLEAR"||next=="MEM"||next=="SAVEVARS"||next=="LOADVARS"){
+            scanner.saveToken(next);
+            Command statement_1(scanner);
+            statement_1.execute(state,program);
+        }
+        else{
+            error("SYNTAXERROR");
+        }
+        break;
+    }
+    default: {
+        error("SYNTAXERROR");
+    }
+    }
+}
+
+bool isRunCommand(const std::string &line) {
+    TokenScanner scanner;
+    scanner.ignoreWhitespace();
+    scanner.scanNumbers();
+    scanner.setInput(line);
+    return scanner.nextToken() == "RUN";
+}
+
+std::unique_ptr<Statement> parseStatement(const std::string &text) {
+    TokenScanner scanner;
+    scanner.ignoreWhitespace();
+    scanner.scanNumbers();
+    scanner.setInput(text);
+    std::string next = scanner.nextToken();
+    scanner.saveToken(next);
+    if (next == "REM" || next == "LET" || next == "PRINT" || next == "INPUT") {
+        return std::unique_ptr<Statement>(new Sequential(scanner));
+    }
+    else if (next == "GOTO") {
+        return std::unique_ptr<Statement>(new GOTO(scanner));
+    }
+    else if (next == "END") {
+        return std::unique_ptr<Statement>(new END(scanner));
+    }
+    else if (next == "IF") {
+        return std::unique_ptr<Statement>(new IF(scanner));
+    }
+    else if (next == "PARALLEL") {
+        return std::unique_ptr<Statement>(new PARALLEL(scanner));
+    }
+    else if (next == "NEXT") {
+        return std::unique_ptr<Statement>(new NEXT(scanner));
+    }
+    error("SYNTAXERROR");
+    return nullptr;
+}
+
+void storeLine(Program &program, int number, const std::string &say, std::unique_ptr<Statement> statement) {
+    statement->validate();
+    program.addSourceLine(number, say, std::move(statement));
+}
+
+void tokenToString(TokenScanner& copies, std::string& object) {
+    while (copies.hasMoreTokens()) {
+        object += copies.nextToken();
+        object += ' ';
+    }
+}
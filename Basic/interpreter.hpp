@@ -0,0 +1,75 @@
+/*
+ * File: interpreter.h
+ * -------------------
+ * This interface exports the functions that process the lines typed
+ * by the user, so that the console and the server can share them.
+ */
+
+#ifndef _interpreter_h
+#define _interpreter_h
+
+#include <memory>
+#include <string>
+#include "program.hpp"
+#include "evalstate.hpp"
+#include "Utils/tokenScanner.hpp"
+
+/*
+ * Function: processLine
+ * Usage: processLine(line, program, state);
+ * -----------------------------------------
+ * Processes a single line entered by the user.  A line that begins
+ * with a number is parsed and stored in the program, or removes the
+ * line with that number if nothing follows it.  Any other line is one
+ * of the commands LET, PRINT, INPUT, RUN, LIST, CLEAR, MEM, SAVEVARS,
+ * LOADVARS, HELP or QUIT and is executed immediately.  Output goes to the stream of the state, and
+ * QUIT only records the request in the state, so that the caller can
+ * decide what ending the session means.
+ */
+
+void processLine(std::string line, Program &program, EvalState &state);
+
+/*
+ * Function: isRunCommand
+ * Usage: if (isRunCommand(line)) . . .
+ * ------------------------------------
+ * Returns true if processLine would execute the line as RUN, so that a
+ * caller can run the program in slices instead.
+ */
+
+bool isRunCommand(const std::string &line);
+
+/*
+ * Function: parseStatement
+ * Usage: std::unique_ptr<Statement> stmt = parseStatement(text);
+ * --------------------------------------------------------------
+ * Parses the text of a program line without its number, as stored by
+ * storeLine, and returns the new statement.  The statement is not
+ * validated.  A line that fails to parse raises an error without
+ * leaving any part of the statement allocated.
+ */
+
+std::unique_ptr<Statement> parseStatement(const std::string &text);
+
+/*
+ * Function: storeLine
+ * Usage: storeLine(program, number, say, std::move(statement));
+ * -------------------------------------------------------------
+ * Validates a freshly parsed program line and hands it to the program.
+ * A line that fails validation is freed and the error is passed on,
+ * leaving any previous line with the same number in place.
+ */
+
+void storeLine(Program &program, int number, const std::string &say, std::unique_ptr<Statement> statement);
+
+/*
+ * Function: tokenToString
+ * Usage: tokenToString(scanner, text);
+ * ------------------------------------
+ * Appends the remaining tokens of the scanner to text, each followed by
+ * a single space.
+ */
+
+void tokenToString(TokenScanner& copies, std::string& object);
+
+#endif
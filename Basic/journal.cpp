@@ -0,0 +1,256 @@
+/*
+ * File: journal.cpp
+ * -----------------
+ * Implements the journal.h interface.
+ */
+
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "journal.hpp"
+#include "files.hpp"
+#include "imagecache.hpp"
+#include "program.hpp"
+#include "statement.hpp"
+#include "Utils/error.hpp"
+
+/*
+ * Implementation notes: file format
+ * ---------------------------------
+ * The header is followed by the records.  A record is a checksum, a
+ * kind, a line number and the lengths of the text and the code that
+ * follow it; 'a' adds a line, 'r' removes one and 'c' removes them all,
+ * and only 'a' has text and code.  The code is that of writeStatement.
+ * The checksum is a 32-bit FNV-1a hash of the rest of the record.
+ * Integers are in the byte order of the machine.  Records are not
+ * padded, so each one is copied out of the mapping before it is read.
+ *
+ * Each record is written with a single call at the end of the file.
+ * Reading stops at the first record that is incomplete or whose
+ * checksum does not match, which is where a process that died while
+ * writing it left off.  Any change to the layout or to the code of the
+ * image cache must change the version.
+ */
+
+namespace {
+
+const char MAGIC[8] = {'B', 'A', 'S', 'I', 'J', 'R', 'N', 'L'};
+const uint32_t VERSION = 1;
+const uint64_t COMPACT_SLACK = 65536;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct Record {
+    uint32_t check;
+    char kind;
+    char reserved[3];
+    int32_t number;
+    uint32_t text;
+    uint32_t code;
+};
+
+uint32_t checkRecord(const char *record, uint64_t bytes) {
+    return hashFNV32(record + sizeof(uint32_t), bytes - sizeof(uint32_t));
+}
+
+bool writeAll(int fd, const char *data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t written = pwrite(fd, data, size, offset);
+        if (written <= 0) return false;
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+}
+
+EditJournal::EditJournal(const std::string &path) : path_(path) {
+}
+
+EditJournal::~EditJournal() {
+    if (fd_ >= 0) close(fd_);
+}
+
+/*
+ * Implementation notes: attach
+ * ----------------------------
+ * One pass over the records finds the last one of each line, and only
+ * those are decoded and added to the program.  The file is then
+ * compacted, which also drops whatever followed the last complete
+ * record, so appending starts from a clean end.  A file that is not
+ * empty but has no valid header, such as a file of some other kind or
+ * a journal of another version, is refused before anything is written.
+ */
+
+bool EditJournal::attach(Program &program) {
+    int fd = open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) close(fd);
+        error("CANNOT OPEN JOURNAL");
+    }
+    size_t size = info.st_size;
+    live_.clear();
+    liveBytes_ = 0;
+    std::vector<std::pair<int, std::string>> texts;
+    std::vector<std::unique_ptr<Statement>> statements;
+    if (size > 0) {
+        void *mapped = size >= sizeof(Header) ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        const Header *header = (const Header *) mapped;
+        if (mapped == MAP_FAILED || memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION) {
+            if (mapped != MAP_FAILED) munmap(mapped, size);
+            close(fd);
+            error("CANNOT OPEN JOURNAL");
+        }
+        const char *base = (const char *) mapped;
+        uint64_t offset = sizeof(Header);
+        while (size - offset >= sizeof(Record)) {
+            Record record;
+            memcpy(&record, base + offset, sizeof(Record));
+            uint64_t bytes = sizeof(Record) + (uint64_t) record.text + record.code;
+            if (bytes > size - offset || record.check != checkRecord(base + offset, bytes)) break;
+            if (record.kind == 'a') {
+                live_[record.number] = {offset, (uint32_t) bytes};
+            }
+            else if (record.kind == 'r') {
+                live_.erase(record.number);
+            }
+            else if (record.kind == 'c') {
+                live_.clear();
+            }
+            else {
+                break;
+            }
+            offset += bytes;
+        }
+        try {
+            for (auto &line : live_) {
+                const char *start = base + line.second.first;
+                Record record;
+                memcpy(&record, start, sizeof(Record));
+                const char *text = start + sizeof(Record);
+                texts.push_back({line.first, std::string(text, record.text)});
+                statements.push_back(readStatement(text + record.text, text + record.text + record.code));
+                liveBytes_ += line.second.second;
+            }
+        }
+        catch (ErrorException &ex) {
+            munmap(mapped, size);
+            close(fd);
+            live_.clear();
+            error("DAMAGED JOURNAL");
+        }
+        munmap(mapped, size);
+    }
+    fd_ = fd;
+    if (!compact()) {
+        close(fd_);
+        fd_ = -1;
+        error("CANNOT OPEN JOURNAL");
+    }
+    for (size_t i = 0; i < statements.size(); ++i) {
+        program.addSourceLine(texts[i].first, texts[i].second, std::move(statements[i]));
+    }
+    program.setJournal(this);
+    return !statements.empty();
+}
+
+void EditJournal::add(int lineNumber, const std::string &line, Statement *stmt) {
+    std::string payload = line;
+    writeStatement(payload, stmt);
+    append('a', lineNumber, payload, (uint32_t) line.size());
+}
+
+void EditJournal::remove(int lineNumber) {
+    if (live_.find(lineNumber) == live_.end()) return;
+    append('r', lineNumber, "", 0);
+}
+
+void EditJournal::clear() {
+    if (live_.empty()) return;
+    append('c', -1, "", 0);
+}
+
+/*
+ * Implementation notes: append
+ * ----------------------------
+ * A record that could not be written in full is cut off again, so that
+ * it cannot hide the records written after it.  Compacting when the
+ * superseded records outgrow the live ones by COMPACT_SLACK bytes keeps
+ * the file within twice the size of the program, plus that slack.
+ */
+
+void EditJournal::append(char kind, int lineNumber, const std::string &payload, uint32_t text) {
+    std::string data(sizeof(Record), '\0');
+    Record *record = (Record *) &data[0];
+    record->kind = kind;
+    record->number = lineNumber;
+    record->text = text;
+    record->code = (uint32_t) payload.size() - text;
+    data += payload;
+    ((Record *) &data[0])->check = checkRecord(data.data(), data.size());
+    if (!writeAll(fd_, data.data(), data.size(), size_)) {
+        if (ftruncate(fd_, size_) != 0) {
+            // The tail fails its checksum and is dropped on the next attach.
+        }
+        error("CANNOT WRITE JOURNAL");
+    }
+    if (kind == 'a') {
+        auto iter = live_.find(lineNumber);
+        if (iter != live_.end()) liveBytes_ -= (*iter).second.second;
+        live_[lineNumber] = {size_, (uint32_t) data.size()};
+        liveBytes_ += data.size();
+    }
+    else if (kind == 'r') {
+        auto iter = live_.find(lineNumber);
+        liveBytes_ -= (*iter).second.second;
+        live_.erase(iter);
+    }
+    else {
+        live_.clear();
+        liveBytes_ = 0;
+    }
+    size_ += data.size();
+    if (size_ - sizeof(Header) > 2 * liveBytes_ + COMPACT_SLACK) compact();
+}
+
+/*
+ * Implementation notes: compact
+ * -----------------------------
+ * The live records replace the journal through replaceFile, so that a
+ * crash leaves either the old journal or the new one.  If that fails
+ * the old file stays in use.
+ */
+
+bool EditJournal::compact() {
+    std::string data(sizeof(Header), '\0');
+    Header *header = (Header *) &data[0];
+    memcpy(header->magic, MAGIC, sizeof(MAGIC));
+    header->version = VERSION;
+    std::map<int, std::pair<uint64_t, uint32_t>> live;
+    for (auto &line : live_) {
+        uint64_t offset = data.size();
+        data.resize(offset + line.second.second);
+        if (pread(fd_, &data[offset], line.second.second, line.second.first) != (ssize_t) line.second.second) {
+            return false;
+        }
+        live[line.first] = {offset, line.second.second};
+    }
+    int fd;
+    if (!replaceFile(path_, data, &fd)) return false;
+    close(fd_);
+    fd_ = fd;
+    size_ = data.size();
+    live_ = std::move(live);
+    return true;
+}
@@ -0,0 +1,117 @@
+/*
+ * File: journal.h
+ * ---------------
+ * This interface exports the EditJournal class, which records the edits
+ * made to a Program in a file, so that the program can be rebuilt after
+ * the process ends.
+ */
+
+#ifndef _journal_h
+#define _journal_h
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+
+class Program;
+class Statement;
+
+/*
+ * Class: EditJournal
+ * ------------------
+ * An EditJournal appends every line added to or removed from a program,
+ * and every CLEAR, to a file as it happens.  A process that attaches to
+ * the file later, even after the previous one crashed, starts with the
+ * program as it was after the last completed edit.
+ *
+ * A line is recorded with its text and its statement in the flattened
+ * form of the image cache, so the program is rebuilt without parsing
+ * anything.  Only the last record of each line counts, and the file is
+ * compacted to those records whenever the others take up more room
+ * than they do, so rebuilding the program takes time proportional to
+ * its size rather than to the number of edits that produced it.
+ *
+ * The file is a small header followed by the records, each with a
+ * checksum.  The header carries a magic number and a format version,
+ * and attach refuses a file with another version rather than overwrite
+ * it.
+ */
+
+class EditJournal {
+
+public:
+
+/*
+ * Constructor: EditJournal
+ * Usage: EditJournal journal(path);
+ * ---------------------------------
+ * Creates a journal that uses the file at path.  The file is not
+ * touched until attach is called.
+ */
+
+    explicit EditJournal(const std::string &path);
+
+/*
+ * Destructor: ~EditJournal
+ * Usage: usually implicit
+ * -----------------------
+ * Closes the file.  The program must not be attached to the journal
+ * any more.
+ */
+
+    ~EditJournal();
+
+    EditJournal(const EditJournal &) = delete;
+    EditJournal &operator=(const EditJournal &) = delete;
+
+/*
+ * Method: attach
+ * Usage: bool restored = journal.attach(program);
+ * -----------------------------------------------
+ * Opens the file, creating it if needed, adds the lines recorded in it
+ * to program, which should be empty, and attaches the journal to
+ * program.  Records after the last complete one, as a crash in the
+ * middle of an edit leaves them, are dropped.  Returns true if the file
+ * held any lines.  Raises an error, leaving the file as it is, if it
+ * cannot be opened or is neither empty nor a journal in the current
+ * format.
+ */
+
+    bool attach(Program &program);
+
+/*
+ * Methods: add, remove, clear
+ * Usage: journal.add(lineNumber, line, stmt);
+ * -------------------------------------------
+ * Called by an attached Program before it stores a line, removes one
+ * or removes all of them.  Raise an error, leaving the journal as it
+ * was, if the record cannot be written.
+ */
+
+    void add(int lineNumber, const std::string &line, Statement *stmt);
+
+    void remove(int lineNumber);
+
+    void clear();
+
+private:
+    std::string path_;
+    int fd_ = -1;
+    //文件的字节数。
+    uint64_t size_ = 0;
+    //行号->其最后一条记录在文件中的偏移与长度。
+    std::map<int, std::pair<uint64_t, uint32_t>> live_;
+    //live_中记录的总字节数。
+    uint64_t liveBytes_ = 0;
+
+    //把一条记录追加到文件末尾。
+    void append(char kind, int lineNumber, const std::string &payload, uint32_t text);
+
+    //只保留live_中的记录，重写文件；失败时返回false，仍用原文件。
+    bool compact();
+
+};
+
+#endif
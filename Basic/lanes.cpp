@@ -0,0 +1,574 @@
+/*
+ * File: lanes.cpp
+ * ---------------
+ * Implements the lanes.h interface.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+#include "lanes.hpp"
+#include "compiled.hpp"
+#include "exptable.hpp"
+#include "imagecache.hpp"
+#include "interpreter.hpp"
+#include "statement.hpp"
+#include "Utils/error.hpp"
+#include "Utils/strlib.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LANES_X86
+#endif
+
+namespace {
+
+typedef uint32_t Mask;
+
+/*
+ * Implementation notes: kernels
+ * -----------------------------
+ * The arithmetic on a whole group goes through a table of kernels that
+ * is chosen once, for the processor the program runs on: AVX2 handles
+ * eight lanes per instruction, SSE4.1 four, and plain loops are used
+ * anywhere else.  The vector kernels are compiled for their instruction
+ * sets through target attributes, so the rest of the program needs no
+ * special flags and still runs on processors without them.  Addition,
+ * subtraction and the low half of a product have the same bits for
+ * signed and unsigned values, so they wrap exactly as the scalar
+ * interpreter does.  A comparison returns one bit per lane, and select
+ * copies the lanes of a mask, which is how an assignment leaves the
+ * inactive lanes alone.  The number of lanes must be a multiple of
+ * eight.
+ */
+
+struct Kernels {
+    void (*add)(const int *a, const int *b, int *result, int n);
+    void (*subtract)(const int *a, const int *b, int *result, int n);
+    void (*multiply)(const int *a, const int *b, int *result, int n);
+    Mask (*compare)(const int *a, const int *b, char op, int n);
+    void (*select)(Mask mask, const int *from, int *to, int n);
+};
+
+void addScalar(const int *a, const int *b, int *result, int n) {
+    for (int i = 0; i < n; ++i) result[i] = (int) ((unsigned) a[i] + (unsigned) b[i]);
+}
+
+void subtractScalar(const int *a, const int *b, int *result, int n) {
+    for (int i = 0; i < n; ++i) result[i] = (int) ((unsigned) a[i] - (unsigned) b[i]);
+}
+
+void multiplyScalar(const int *a, const int *b, int *result, int n) {
+    for (int i = 0; i < n; ++i) result[i] = (int) ((unsigned) a[i] * (unsigned) b[i]);
+}
+
+Mask compareScalar(const int *a, const int *b, char op, int n) {
+    Mask bits = 0;
+    for (int i = 0; i < n; ++i) {
+        bool flag = (op == '>' && a[i] > b[i]) || (op == '=' && a[i] == b[i]) || (op == '<' && a[i] < b[i]);
+        if (flag) bits |= Mask(1) << i;
+    }
+    return bits;
+}
+
+void selectScalar(Mask mask, const int *from, int *to, int n) {
+    for (int i = 0; i < n; ++i) {
+        if (mask >> i & 1) to[i] = from[i];
+    }
+}
+
+#ifdef LANES_X86
+
+__attribute__((target("avx2")))
+void addAVX2(const int *a, const int *b, int *result, int n) {
+    for (int i = 0; i < n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *) (b + i));
+        _mm256_storeu_si256((__m256i *) (result + i), _mm256_add_epi32(x, y));
+    }
+}
+
+__attribute__((target("avx2")))
+void subtractAVX2(const int *a, const int *b, int *result, int n) {
+    for (int i = 0; i < n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *) (b + i));
+        _mm256_storeu_si256((__m256i *) (result + i), _mm256_sub_epi32(x, y));
+    }
+}
+
+__attribute__((target("avx2")))
+void multiplyAVX2(const int *a, const int *b, int *result, int n) {
+    for (int i = 0; i < n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *) (b + i));
+        _mm256_storeu_si256((__m256i *) (result + i), _mm256_mullo_epi32(x, y));
+    }
+}
+
+__attribute__((target("avx2")))
+Mask compareAVX2(const int *a, const int *b, char op, int n) {
+    Mask bits = 0;
+    for (int i = 0; i < n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *) (b + i));
+        __m256i flags = op == '>' ? _mm256_cmpgt_epi32(x, y)
+                      : op == '<' ? _mm256_cmpgt_epi32(y, x)
+                      : op == '=' ? _mm256_cmpeq_epi32(x, y)
+                      : _mm256_setzero_si256();
+        bits |= (Mask) _mm256_movemask_ps(_mm256_castsi256_ps(flags)) << i;
+    }
+    return bits;
+}
+
+__attribute__((target("avx2")))
+void selectAVX2(Mask mask, const int *from, int *to, int n) {
+    const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    for (int i = 0; i < n; i += 8) {
+        __m256i bits = _mm256_and_si256(_mm256_set1_epi32((int) (mask >> i & 0xff)), lanes);
+        __m256i chosen = _mm256_cmpeq_epi32(bits, lanes);
+        _mm256_maskstore_epi32(to + i, chosen, _mm256_loadu_si256((const __m256i *) (from + i)));
+    }
+}
+
+__attribute__((target("sse4.1")))
+void addSSE(const int *a, const int *b, int *result, int n) {
+    for (int i = 0; i < n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *) (b + i));
+        _mm_storeu_si128((__m128i *) (result + i), _mm_add_epi32(x, y));
+    }
+}
+
+__attribute__((target("sse4.1")))
+void subtractSSE(const int *a, const int *b, int *result, int n) {
+    for (int i = 0; i < n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *) (b + i));
+        _mm_storeu_si128((__m128i *) (result + i), _mm_sub_epi32(x, y));
+    }
+}
+
+__attribute__((target("sse4.1")))
+void multiplySSE(const int *a, const int *b, int *result, int n) {
+    for (int i = 0; i < n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *) (b + i));
+        _mm_storeu_si128((__m128i *) (result + i), _mm_mullo_epi32(x, y));
+    }
+}
+
+__attribute__((target("sse4.1")))
+Mask compareSSE(const int *a, const int *b, char op, int n) {
+    Mask bits = 0;
+    for (int i = 0; i < n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *) (b + i));
+        __m128i flags = op == '>' ? _mm_cmpgt_epi32(x, y)
+                      : op == '<' ? _mm_cmplt_epi32(x, y)
+                      : op == '=' ? _mm_cmpeq_epi32(x, y)
+                      : _mm_setzero_si128();
+        bits |= (Mask) _mm_movemask_ps(_mm_castsi128_ps(flags)) << i;
+    }
+    return bits;
+}
+
+__attribute__((target("sse4.1")))
+void selectSSE(Mask mask, const int *from, int *to, int n) {
+    const __m128i lanes = _mm_setr_epi32(1, 2, 4, 8);
+    for (int i = 0; i < n; i += 4) {
+        __m128i bits = _mm_and_si128(_mm_set1_epi32((int) (mask >> i & 0xf)), lanes);
+        __m128i chosen = _mm_cmpeq_epi32(bits, lanes);
+        __m128i old = _mm_loadu_si128((const __m128i *) (to + i));
+        __m128i value = _mm_loadu_si128((const __m128i *) (from + i));
+        _mm_storeu_si128((__m128i *) (to + i), _mm_blendv_epi8(old, value, chosen));
+    }
+}
+
+#endif
+
+Kernels chooseKernels() {
+#ifdef LANES_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return Kernels{addAVX2, subtractAVX2, multiplyAVX2, compareAVX2, selectAVX2};
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return Kernels{addSSE, subtractSSE, multiplySSE, compareSSE, selectSSE};
+    }
+#endif
+    return Kernels{addScalar, subtractScalar, multiplyScalar, compareScalar, selectScalar};
+}
+
+const Kernels &chosenKernels() {
+    static const Kernels chosen = chooseKernels();
+    return chosen;
+}
+
+/*
+ * Implementation notes: LaneRunner
+ * --------------------------------
+ * Every record of a group is a lane with its own line number.  At each
+ * step the lanes at the smallest line execute the statement of that
+ * line together, which brings lanes that took different branches back
+ * into step as soon as they reach the same line.  Variables are stored
+ * as one array of W values per variable, so that the arithmetic of an
+ * expression is done by the kernels on all the lanes at once.
+ * Inactive lanes take part in that arithmetic, which wraps so that
+ * their garbage cannot overflow; only division, which has no vector
+ * instruction, looks at the mask lane by lane.
+ *
+ * A mask says which lanes an evaluation is for.  A lane that raises an
+ * error is removed from the mask at that point, so it skips the rest of
+ * the statement, just as the exception ends the statement in a scalar
+ * run.  Shared and hoisted subexpressions are simply evaluated again,
+ * which gives the same value and the same errors.  INPUT is executed
+ * for each lane by the statement itself, on an EvalState that holds
+ * the input and output of that lane.  Expressions are walked in the
+ * ExpressionTable of the compiled program, whose variable nodes are
+ * mapped to their arrays once, when the runner is built.
+ */
+
+template <int W>
+class LaneRunner {
+
+public:
+
+    LaneRunner(Program &program, const CompiledProgram &image)
+            : program(program), image(image), kernels(chosenKernels()) {
+        for (int line = image.getFirstLineNumber(); line != -1; line = image.getNextLineNumber(line)) {
+            Statement *stmt = image.getParsedStatement(line);
+            if (stmt->getType() == INPUT_STMT) variable(((Sequential *) stmt)->getVariable());
+            for (Expression **root : stmt->getExpressions()) collect(*root);
+        }
+    }
+
+    void run(const std::vector<std::string> &records, std::ostream &out) {
+        int count = (int) records.size();
+        std::vector<Lane> lanes(count);
+        Mask alive = 0;
+        for (int lane = 0; lane < count; ++lane) {
+            lanes[lane].in.str(records[lane]);
+            lanes[lane].io.setInput(lanes[lane].in);
+            lanes[lane].io.setOutput(lanes[lane].out);
+            lanes[lane].pc = image.getFirstLineNumber();
+            if (lanes[lane].pc != -1) alive |= Mask(1) << lane;
+        }
+        std::fill(defined.begin(), defined.end(), 0);
+        this->lanes = &lanes;
+        while (alive != 0) {
+            int line = -1;
+            for (int lane = 0; lane < count; ++lane) {
+                if ((alive >> lane & 1) && (line == -1 || lanes[lane].pc < line)) line = lanes[lane].pc;
+            }
+            Mask group = 0;
+            for (int lane = 0; lane < count; ++lane) {
+                if ((alive >> lane & 1) && lanes[lane].pc == line) group |= Mask(1) << lane;
+            }
+            Mask jumped = execute(image.getParsedStatement(line), line, group);
+            int next = image.getNextLineNumber(line);
+            for (int lane = 0; lane < count; ++lane) {
+                Mask bit = Mask(1) << lane;
+                if (!(alive & bit)) continue;
+                if (!lanes[lane].message.empty()) alive &= ~bit;
+                else if ((group & bit) && !(jumped & bit)) lanes[lane].pc = next;
+                if (lanes[lane].pc == -1) alive &= ~bit;
+            }
+        }
+        for (Lane &lane : lanes) {
+            out << lane.out.str();
+            if (!lane.message.empty()) out << lane.message << '\n';
+        }
+    }
+
+private:
+
+    struct Lane {
+        EvalState io;
+        std::istringstream in;
+        std::ostringstream out;
+        int pc = -1;
+        std::string message;
+    };
+
+    Program &program;
+    const CompiledProgram &image;
+    const Kernels &kernels;
+    std::unordered_map<int, int> names;
+    //编译后的表达式所在的表，及其中每个变量节点对应的变量。
+    const ExpressionTable *table = nullptr;
+    std::vector<int> slots;
+    std::vector<std::vector<int>> values;
+    std::vector<Mask> defined;
+    std::vector<Lane> *lanes = nullptr;
+
+    int variable(int symbol) {
+        auto iter = names.find(symbol);
+        if (iter != names.end()) return (*iter).second;
+        int index = (int) values.size();
+        names[symbol] = index;
+        values.push_back(std::vector<int>(W));
+        defined.push_back(0);
+        return index;
+    }
+
+    void collect(Expression *root) {
+        table = &((FlatExp *) root)->getTable();
+        slots.resize(table->size(), -1);
+        collect(((FlatExp *) root)->getNode());
+    }
+
+    void collect(int node) {
+        switch (table->getKind(node)) {
+        case ExpressionTable::NODE_CONSTANT:
+            break;
+        case ExpressionTable::NODE_VARIABLE:
+            slots[node] = variable(table->getFirst(node));
+            break;
+        case ExpressionTable::NODE_ASSIGN:
+            slots[node] = variable(table->getFirst(node));
+            collect(table->getSecond(node));
+            break;
+        case ExpressionTable::NODE_SHARED:
+        case ExpressionTable::NODE_HOISTED:
+            collect(table->getSecond(node));
+            break;
+        default:
+            collect(table->getFirst(node));
+            collect(table->getSecond(node));
+            break;
+        }
+    }
+
+    void fail(Mask &mask, Mask failed, const std::string &message) {
+        for (int lane = 0; lane < W; ++lane) {
+            if (failed >> lane & 1) (*lanes)[lane].message = message;
+        }
+        mask &= ~failed;
+    }
+
+    void eval(Expression *root, Mask &mask, int *result) {
+        eval(((FlatExp *) root)->getNode(), mask, result);
+    }
+
+    void eval(int node, Mask &mask, int *result) {
+        ExpressionTable::NodeKind kind = table->getKind(node);
+        switch (kind) {
+        case ExpressionTable::NODE_CONSTANT: {
+            int value = table->getFirst(node);
+            for (int lane = 0; lane < W; ++lane) result[lane] = value;
+            return;
+        }
+        case ExpressionTable::NODE_VARIABLE: {
+            int index = slots[node];
+            fail(mask, mask & ~defined[index], "VARIABLE NOT DEFINED");
+            const int *value = values[index].data();
+            for (int lane = 0; lane < W; ++lane) result[lane] = value[lane];
+            return;
+        }
+        case ExpressionTable::NODE_ASSIGN: {
+            eval(table->getSecond(node), mask, result);
+            int index = slots[node];
+            kernels.select(mask, result, values[index].data(), W);
+            defined[index] |= mask;
+            return;
+        }
+        case ExpressionTable::NODE_SHARED:
+        case ExpressionTable::NODE_HOISTED:
+            eval(table->getSecond(node), mask, result);
+            return;
+        default:
+            break;
+        }
+        int left[W], right[W];
+        eval(table->getFirst(node), mask, left);
+        eval(table->getSecond(node), mask, right);
+        if (kind == ExpressionTable::NODE_ADD) {
+            kernels.add(left, right, result, W);
+        }
+        else if (kind == ExpressionTable::NODE_SUBTRACT) {
+            kernels.subtract(left, right, result, W);
+        }
+        else if (kind == ExpressionTable::NODE_MULTIPLY) {
+            kernels.multiply(left, right, result, W);
+        }
+        else {
+            static const int zeros[W] = {};
+            fail(mask, mask & kernels.compare(right, zeros, '=', W), "DIVIDE BY ZERO");
+            for (int lane = 0; lane < W; ++lane) {
+                if (!(mask >> lane & 1)) result[lane] = 0;
+                else if (right[lane] == -1) result[lane] = (int) (0u - (unsigned) left[lane]);
+                else result[lane] = left[lane] / right[lane];
+            }
+        }
+    }
+
+    //执行行line处的语句，返回跳转了的通道（包括跳转失败而出错的通道）。
+    Mask execute(Statement *stmt, int line, Mask group) {
+        int result[W];
+        switch (stmt->getType()) {
+        case LET_STMT:
+            eval(*stmt->getExpressions()[0], group, result);
+            return 0;
+        case PRINT_STMT:
+            eval(*stmt->getExpressions()[0], group, result);
+            for (int lane = 0; lane < W; ++lane) {
+                if (group >> lane & 1) (*lanes)[lane].out << result[lane] << '\n';
+            }
+            return 0;
+        case INPUT_STMT:
+            input((Sequential *) stmt, group);
+            return 0;
+        case GOTO_STMT:
+        case END_STMT:
+            return jump(((Control *) stmt)->getTarget(), line, group);
+        case IF_STMT: {
+            IF *branch = (IF *) stmt;
+            int left[W], right[W];
+            eval(branch->getLHS(), group, left);
+            eval(branch->getRHS(), group, right);
+            Mask taken = kernels.compare(left, right, branch->getCompare(), W);
+            return jump(branch->getTarget(), line, group & taken);
+        }
+        default:
+            return 0;
+        }
+    }
+
+    //与Control::jump及run_program_一致：跳到本行等于顺序执行。
+    Mask jump(int target, int line, Mask group) {
+        if (target == line) return 0;
+        if (target != -1 && !image.hasLine(target)) {
+            fail(group, group, "LINE NUMBER ERROR");
+            return 0;
+        }
+        for (int lane = 0; lane < W; ++lane) {
+            if (group >> lane & 1) (*lanes)[lane].pc = target;
+        }
+        return group;
+    }
+
+    void input(Sequential *stmt, Mask group) {
+        int index = variable(stmt->getVariable());
+        for (int lane = 0; lane < W; ++lane) {
+            if (!(group >> lane & 1)) continue;
+            Lane &state = (*lanes)[lane];
+            try {
+                stmt->execute(state.io, program);
+                values[index][lane] = state.io.getValue(stmt->getVariable());
+                defined[index] |= Mask(1) << lane;
+            }
+            catch (ErrorException &ex) {
+                state.message = ex.getMessage();
+            }
+        }
+    }
+
+};
+
+std::string splitRecord(const std::string &record) {
+    std::istringstream words(record);
+    std::string word, lines;
+    while (words >> word) {
+        lines += word;
+        lines += '\n';
+    }
+    return lines;
+}
+
+void runScalar(Program &program, const std::string &record, std::ostream &out) {
+    std::istringstream in(record);
+    std::ostringstream text;
+    EvalState state;
+    state.setInput(in);
+    state.setOutput(text);
+    try {
+        program.run_program_(state);
+    }
+    catch (ErrorException &ex) {
+        text << ex.getMessage() << '\n';
+    }
+    out << text.str();
+}
+
+template <int W>
+void runGroups(Program &program, const CompiledProgram &image, std::istream &records, std::ostream &out) {
+    LaneRunner<W> runner(program, image);
+    std::vector<std::string> group;
+    std::string line;
+    bool more = true;
+    while (more) {
+        more = (bool) getline(records, line);
+        if (more) group.push_back(splitRecord(line));
+        if (group.size() == W || (!more && !group.empty())) {
+            runner.run(group, out);
+            group.clear();
+        }
+    }
+}
+
+}
+
+/*
+ * Implementation notes: runLanes
+ * ------------------------------
+ * A lane of a PARALLEL FOR would need a private copy of every variable
+ * for each chunk of the loop, so such programs fall back to RUN on one
+ * record at a time.  So do programs with limits, which a run checks at
+ * points that lanes sharing a statement do not reach together.
+ */
+
+int runLanes(const std::string &path, int width, const std::string &cache, const RunLimits &limits,
+             std::istream &records, std::ostream &out) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot read " << path << std::endl;
+        return 1;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    std::string text = contents.str();
+    std::istringstream source(text);
+    Program program;
+    EvalState state;
+    std::shared_ptr<const CompiledProgram> image;
+    try {
+        bool cached = !cache.empty() && loadCachedProgram(cache, text, program);
+        std::string line;
+        while (!cached && getline(source, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (trim(line).empty()) continue;
+            if (!isdigit((unsigned char) trim(line)[0])) error("Only numbered lines are allowed: " + line);
+            processLine(line, program, state);
+        }
+        if (!cache.empty() && !cached) saveCachedProgram(cache, text, program);
+        image = program.getCompiledProgram();
+    }
+    catch (ErrorException &ex) {
+        std::cerr << path << ": " << ex.getMessage() << std::endl;
+        return 1;
+    }
+    bool scalar = limits.isLimited();
+    program.setRunLimits(limits);
+    for (int line = image->getFirstLineNumber(); line != -1; line = image->getNextLineNumber(line)) {
+        if (image->getParsedStatement(line)->getType() == PARALLEL_STMT) scalar = true;
+    }
+    if (scalar) {
+        std::string record;
+        while (getline(records, record)) {
+            runScalar(program, splitRecord(record), out);
+        }
+    }
+    else if (width == 16) {
+        runGroups<16>(program, *image, records, out);
+    }
+    else {
+        runGroups<8>(program, *image, records, out);
+    }
+    out.flush();
+    return 0;
+}
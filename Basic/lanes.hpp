@@ -0,0 +1,41 @@
+/*
+ * File: lanes.h
+ * -------------
+ * This interface exports the lanes mode of the interpreter, which runs
+ * one program over many sets of input at once.
+ */
+
+#ifndef _lanes_h
+#define _lanes_h
+
+#include <iostream>
+#include <string>
+#include "program.hpp"
+
+/*
+ * Function: runLanes
+ * Usage: return runLanes(path, width, cache, limits, std::cin, std::cout);
+ * ------------------------------------------------------------------------
+ * Loads the numbered lines of the file path as a program and RUNs it
+ * once for every line of records.  The words of a record, separated by
+ * spaces, are the lines its INPUT statements read.  The output of each
+ * run, ending with the message of the error that stopped it if any, is
+ * written to out in the order of the records, exactly as separate runs
+ * of the program would produce it.
+ *
+ * Records are processed width at a time, where width is 8 or 16.  The
+ * program is executed once for the whole group: every variable holds a
+ * value per record, the records at the same line execute each statement
+ * together, and records whose IF branches differ continue separately
+ * until they reach the same line again.  Programs with a PARALLEL FOR
+ * are run one record at a time, and so are all programs when limits
+ * sets any, each record being a separate RUN with limits of its own.
+ * Unless cache is empty, the program is loaded through the image cache
+ * in that directory.  The function returns zero unless the program
+ * could not be loaded.
+ */
+
+int runLanes(const std::string &path, int width, const std::string &cache, const RunLimits &limits,
+             std::istream &records, std::ostream &out);
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * File: linestore.cpp
+ * -------------------
+ * Implements the linestore.h interface.
+ */
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include "linestore.hpp"
+#include "files.hpp"
+#include "memory.hpp"
+#include "symbols.hpp"
+
+/*
+ * Implementation notes: encoding
+ * ------------------------------
+ * Each token of a line is followed by an implicit space.  A byte from
+ * 0x80 up stands for a keyword from the table below, and a printable
+ * character that is neither a letter nor a digit stands for itself,
+ * which covers every operator.  The other tokens start with a tag:
+ * NAME and the symbol of the name, as given by internSymbol, INTEGER
+ * and the value, for numbers written in the usual way, or RAW and the
+ * length and the bytes of any other token.  The words of a comment are
+ * RAW tokens, so that they do not become symbols.  Symbols, values and
+ * lengths are stored in seven-bit groups, lowest first, with the high
+ * bit set on all groups but the last, so that most take a single byte.
+ * If the text does not end with a space, its end is a RAW_END token
+ * without one.
+ *
+ * The lines are indexed by a map from their numbers to their place in
+ * the arena, so storing or removing a line never moves the others.
+ * Lines replaced or removed leave their bytes behind in the arena, and
+ * the arena is rebuilt without them once they are the larger part,
+ * which spreads the cost of rebuilding over the edits that made it
+ * necessary.
+ *
+ * Since symbols are the same in every store, a text has the same bytes
+ * in every store, and sameLines compares the bytes.  The hash of the
+ * store is the sum of a hash of the bytes of each line, so storing or
+ * removing a line only adds or subtracts the hash of that line.
+ */
+
+namespace {
+
+const unsigned char NAME = 0x01;
+const unsigned char INTEGER = 0x02;
+const unsigned char RAW = 0x03;
+const unsigned char RAW_END = 0x04;
+const unsigned char KEYWORD = 0x80;
+
+const char *const KEYWORDS[] = {
+    "REM", "LET", "PRINT", "INPUT", "END", "GOTO", "IF", "THEN",
+    "PARALLEL", "FOR", "TO", "NEXT", "SUM", "MIN", "MAX",
+    "RUN", "LIST", "CLEAR", "QUIT", "HELP"
+};
+
+const int KEYWORD_COUNT = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+
+bool isWord(const std::string &token) {
+    if (token.empty() || isdigit((unsigned char) token[0])) return false;
+    for (unsigned char ch : token) {
+        if (!isalnum(ch) && ch != '_') return false;
+    }
+    return true;
+}
+
+bool isInteger(const std::string &token) {
+    if (token.empty() || token.size() > 9 || (token[0] == '0' && token.size() > 1)) return false;
+    for (unsigned char ch : token) {
+        if (!isdigit(ch)) return false;
+    }
+    return true;
+}
+
+uint64_t hashLine(int lineNumber, const unsigned char *p, uint32_t length) {
+    return hashFNV64(p, length) ^ ((uint64_t) (uint32_t) lineNumber * 0x9E3779B97F4A7C15ULL);
+}
+
+uint32_t getNumber(const unsigned char *&p) {
+    uint32_t value = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+        value |= (uint32_t) (*p++ & 0x7f) << shift;
+        shift += 7;
+    }
+    value |= (uint32_t) *p++ << shift;
+    return value;
+}
+
+/*
+ * Passes the text of the line stored in the length bytes at p, piece by
+ * piece, to put.
+ */
+
+template <typename Put>
+void decode(const unsigned char *p, uint32_t length, Put put) {
+    const unsigned char *end = p + length;
+    char digits[16];
+    while (p < end) {
+        unsigned char tag = *p++;
+        if (tag >= KEYWORD) {
+            const char *keyword = KEYWORDS[tag - KEYWORD];
+            put(keyword, strlen(keyword));
+        }
+        else if (tag == NAME) {
+            const std::string &name = getSymbolName(getNumber(p));
+            put(name.data(), name.size());
+        }
+        else if (tag == INTEGER) {
+            put(digits, snprintf(digits, sizeof(digits), "%u", getNumber(p)));
+        }
+        else if (tag == RAW || tag == RAW_END) {
+            uint32_t count = getNumber(p);
+            put((const char *) p, count);
+            p += count;
+            if (tag == RAW_END) break;
+        }
+        else {
+            put((const char *) &tag, 1);
+        }
+        put(" ", 1);
+    }
+}
+
+}
+
+const LineStore::Entry *LineStore::find(int lineNumber) const {
+    auto iter = entries_.find(lineNumber);
+    return iter == entries_.end() ? nullptr : &(*iter).second;
+}
+
+void LineStore::set(int lineNumber, const std::string &text) {
+    uint32_t offset = arena_.size();
+    encode(text);
+    Entry entry = {offset, (uint32_t) (arena_.size() - offset)};
+    hash_ += hashLine(lineNumber, arena_.data() + offset, entry.length);
+    auto result = entries_.emplace(lineNumber, entry);
+    if (!result.second) {
+        Entry &old = (*result.first).second;
+        hash_ -= hashLine(lineNumber, arena_.data() + old.offset, old.length);
+        garbage_ += old.length;
+        old = entry;
+    }
+    compact();
+}
+
+void LineStore::remove(int lineNumber) {
+    auto iter = entries_.find(lineNumber);
+    if (iter == entries_.end()) return;
+    hash_ -= hashLine(lineNumber, arena_.data() + (*iter).second.offset, (*iter).second.length);
+    garbage_ += (*iter).second.length;
+    entries_.erase(iter);
+    compact();
+}
+
+void LineStore::clear() {
+    entries_.clear();
+    arena_.clear();
+    arena_.shrink_to_fit();
+    garbage_ = 0;
+    hash_ = 0;
+}
+
+std::string LineStore::get(int lineNumber) const {
+    std::string text;
+    const Entry *entry = find(lineNumber);
+    if (entry != nullptr) {
+        decode(arena_.data() + entry->offset, entry->length, [&text](const char *s, size_t n) { text.append(s, n); });
+    }
+    return text;
+}
+
+void LineStore::write(int lineNumber, std::ostream &out) const {
+    const Entry *entry = find(lineNumber);
+    if (entry != nullptr) {
+        decode(arena_.data() + entry->offset, entry->length, [&out](const char *s, size_t n) { out.write(s, n); });
+    }
+}
+
+uint64_t LineStore::getHash() const {
+    return hash_;
+}
+
+bool LineStore::sameLines(const LineStore &other) const {
+    if (entries_.size() != other.entries_.size()) return false;
+    for (auto iter = entries_.begin(), match = other.entries_.begin(); iter != entries_.end(); ++iter, ++match) {
+        const Entry &mine = (*iter).second;
+        const Entry &theirs = (*match).second;
+        if ((*iter).first != (*match).first || mine.length != theirs.length
+            || memcmp(arena_.data() + mine.offset, other.arena_.data() + theirs.offset, mine.length) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t LineStore::getBytes() const {
+    return treeBytes(entries_.size(), sizeof(std::pair<const int, Entry>)) + vectorBytes(arena_);
+}
+
+void LineStore::encode(const std::string &text) {
+    size_t start = 0;
+    size_t space;
+    bool comment = false;
+    while ((space = text.find(' ', start)) != std::string::npos) {
+        std::string token = text.substr(start, space - start);
+        if (comment) putRaw(token);
+        else encodeToken(token);
+        comment = comment || token == "REM";
+        start = space + 1;
+    }
+    if (start < text.size()) {
+        arena_.push_back(RAW_END);
+        putNumber(text.size() - start);
+        arena_.insert(arena_.end(), text.begin() + start, text.end());
+    }
+}
+
+void LineStore::encodeToken(const std::string &token) {
+    if (isWord(token)) {
+        for (int i = 0; i < KEYWORD_COUNT; ++i) {
+            if (token == KEYWORDS[i]) {
+                arena_.push_back(KEYWORD + i);
+                return;
+            }
+        }
+        arena_.push_back(NAME);
+        putNumber(internSymbol(token));
+    }
+    else if (isInteger(token)) {
+        arena_.push_back(INTEGER);
+        putNumber(std::stoul(token));
+    }
+    else if (token.size() == 1 && token[0] > ' ' && token[0] < 0x7f) {
+        arena_.push_back(token[0]);
+    }
+    else {
+        putRaw(token);
+    }
+}
+
+void LineStore::putRaw(const std::string &token) {
+    arena_.push_back(RAW);
+    putNumber(token.size());
+    arena_.insert(arena_.end(), token.begin(), token.end());
+}
+
+void LineStore::putNumber(uint32_t value) {
+    while (value >= 0x80) {
+        arena_.push_back((unsigned char) (value | 0x80));
+        value >>= 7;
+    }
+    arena_.push_back((unsigned char) value);
+}
+
+void LineStore::compact() {
+    if (garbage_ < 4096 || garbage_ < arena_.size() / 2) return;
+    std::vector<unsigned char> arena;
+    arena.reserve(arena_.size() - garbage_);
+    for (auto &line : entries_) {
+        Entry &entry = line.second;
+        uint32_t offset = arena.size();
+        arena.insert(arena.end(), arena_.begin() + entry.offset, arena_.begin() + entry.offset + entry.length);
+        entry.offset = offset;
+    }
+    arena_.swap(arena);
+    garbage_ = 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * File: linestore.h
+ * -----------------
+ * This interface exports the LineStore class, which keeps the text of
+ * the lines of a program in tokenized form.
+ */
+
+#ifndef _linestore_h
+#define _linestore_h
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Class: LineStore
+ * ----------------
+ * A LineStore maps line numbers to the normalized text of the lines,
+ * the tokens of each line followed by one space each, as produced by
+ * tokenToString.  Like the BASICs of old, it does not keep that text as
+ * characters: all lines share one byte arena in which keywords and
+ * operators are one byte each, identifiers are their symbols and
+ * integers are packed.  The text is rebuilt whenever it is
+ * asked for, exactly as it was stored.
+ */
+
+class LineStore {
+
+public:
+
+/*
+ * Method: set
+ * Usage: store.set(lineNumber, text);
+ * -----------------------------------
+ * Stores text as the line with the specified number, replacing any
+ * text the line had.
+ */
+
+    void set(int lineNumber, const std::string &text);
+
+/*
+ * Method: remove
+ * Usage: store.remove(lineNumber);
+ * --------------------------------
+ * Removes the line with the specified number, if there is one.
+ */
+
+    void remove(int lineNumber);
+
+/*
+ * Method: clear
+ * Usage: store.clear();
+ * ---------------------
+ * Removes all lines.
+ */
+
+    void clear();
+
+/*
+ * Method: get
+ * Usage: std::string text = store.get(lineNumber);
+ * ------------------------------------------------
+ * Returns the text of the line with the specified number, or the empty
+ * string if there is no such line.
+ */
+
+    std::string get(int lineNumber) const;
+
+/*
+ * Method: write
+ * Usage: store.write(lineNumber, out);
+ * ------------------------------------
+ * Writes the text of the line with the specified number to out, without
+ * building it as a string first.  Nothing is written if there is no
+ * such line.
+ */
+
+    void write(int lineNumber, std::ostream &out) const;
+
+/*
+ * Method: getHash
+ * Usage: uint64_t hash = store.getHash();
+ * ---------------------------------------
+ * Returns a hash of the numbers and the texts of all the lines, which
+ * each change updates without looking at the other lines.  Stores with
+ * the same lines have the same hash.
+ */
+
+    uint64_t getHash() const;
+
+/*
+ * Method: sameLines
+ * Usage: if (store.sameLines(other)) . . .
+ * ----------------------------------------
+ * Returns true if other holds the same lines, with the same texts, as
+ * this store.
+ */
+
+    bool sameLines(const LineStore &other) const;
+
+/*
+ * Method: getBytes
+ * Usage: size_t bytes = store.getBytes();
+ * ---------------------------------------
+ * Returns the bytes of heap memory used by the store.
+ */
+
+    size_t getBytes() const;
+
+private:
+    //一行在arena中的起点与长度。
+    struct Entry {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    //行号->该行的位置。
+    std::map<int, Entry> entries_;
+    std::vector<unsigned char> arena_;
+    //arena中已不属于任何行的字节数，过多时整理。
+    size_t garbage_ = 0;
+    //各行散列值之和，见getHash。
+    uint64_t hash_ = 0;
+
+    const Entry *find(int lineNumber) const;
+    void encode(const std::string &text);
+    void encodeToken(const std::string &token);
+    void putRaw(const std::string &token);
+    void putNumber(uint32_t value);
+    void compact();
+};
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * File: memory.cpp
+ * ----------------
+ * Implements the memory.h interface.
+ */
+
+#include <utility>
+#include "memory.hpp"
+#include "exp.hpp"
+#include "statement.hpp"
+
+/*
+ * Implementation notes: containers
+ * --------------------------------
+ * The estimates follow the layout of the usual standard libraries: a
+ * node of a red-black tree has a color and three links besides its
+ * value, a node of a hash table has one link, and a string keeps up to
+ * fifteen characters inside the object itself.
+ */
+
+size_t stringBytes(const std::string &text) {
+    return text.capacity() > 15 ? text.capacity() + 1 : 0;
+}
+
+size_t treeBytes(size_t count, size_t value) {
+    return count * (4 * sizeof(void *) + value);
+}
+
+size_t hashBytes(size_t count, size_t buckets, size_t value) {
+    return count * (sizeof(void *) + value) + buckets * sizeof(void *);
+}
+
+size_t measureStatement(Statement *stmt) {
+    switch (stmt->getType()) {
+    case REM_STMT:
+    case LET_STMT:
+    case INPUT_STMT:
+    case PRINT_STMT:
+        return sizeof(Sequential);
+    case GOTO_STMT:
+        return sizeof(GOTO);
+    case IF_STMT:
+        return sizeof(IF);
+    case END_STMT:
+        return sizeof(END);
+    case FUSED_STMT:
+        return sizeof(CountedLoop);
+    case PARALLEL_STMT:
+        return sizeof(PARALLEL) + ((PARALLEL *) stmt)->getReductions().capacity() * sizeof(std::pair<char, int>)
+               + ((PARALLEL *) stmt)->getLocals().capacity() * sizeof(int);
+    case NEXT_STMT:
+        return sizeof(NEXT);
+    default:
+        return sizeof(Command);
+    }
+}
+
+size_t measureExpression(Expression *exp) {
+    switch (exp->getType()) {
+    case CONSTANT:
+        return sizeof(ConstantExp);
+    case IDENTIFIER:
+        return sizeof(IdentifierExp);
+    case COMPOUND: {
+        CompoundExp *compound = (CompoundExp *) exp;
+        return sizeof(CompoundExp) + measureExpression(compound->getLHS()) + measureExpression(compound->getRHS());
+    }
+    case SHARED: {
+        SharedExp *shared = (SharedExp *) exp;
+        return sizeof(SharedExp) + (shared->isOwner() ? measureExpression(shared->getExp()) : 0);
+    }
+    case HOISTED:
+        return sizeof(HoistedExp) + measureExpression(((HoistedExp *) exp)->getExp());
+    case FLAT:
+        return sizeof(FlatExp);
+    case POOLED:
+        return sizeof(PooledExp);
+    }
+    return 0;
+}
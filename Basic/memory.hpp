@@ -0,0 +1,86 @@
+/*
+ * File: memory.h
+ * --------------
+ * This interface exports the MemoryStats structure, which reports the
+ * memory used by a program and its variables, and the functions that
+ * estimate the size of the objects and containers they are made of.
+ */
+
+#ifndef _memory_h
+#define _memory_h
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Expression;
+class Statement;
+
+/*
+ * Type: MemoryStats
+ * -----------------
+ * Bytes of heap memory used by the parts of a program: the text of its
+ * lines, the indices that map line numbers to lines and the flow graph,
+ * the statement objects, the expression nodes, the table of symbols,
+ * which the whole process shares, and the variables and caches of an
+ * EvalState.  The figures count the objects and the storage of their
+ * containers, but not the bookkeeping of the allocator.
+ */
+
+struct MemoryStats {
+    size_t source = 0;
+    size_t lines = 0;
+    size_t statements = 0;
+    size_t expressions = 0;
+    size_t symbols = 0;
+    size_t variables = 0;
+
+    size_t total() const {
+        return source + lines + statements + expressions + symbols + variables;
+    }
+};
+
+/*
+ * Functions: measureStatement, measureExpression
+ * Usage: size_t bytes = measureStatement(stmt) + measureExpression(exp);
+ * ----------------------------------------------------------------------
+ * Return the bytes used by a statement object without its expressions,
+ * and by an expression tree.  The shared part of a SharedExp counts
+ * only for the occurrence that owns it, and the expression of a
+ * PooledExp, which belongs to its pool, does not count at all.
+ */
+
+size_t measureStatement(Statement *stmt);
+
+size_t measureExpression(Expression *exp);
+
+/*
+ * Functions: stringBytes, treeBytes, hashBytes
+ * Usage: size_t bytes = treeBytes(set.size(), sizeof(int));
+ * ---------------------------------------------------------
+ * Estimate the heap storage of a string beyond the string object, of
+ * a std::map or std::set with count elements of value bytes each, and
+ * of a std::unordered_map or std::unordered_set with the given number
+ * of elements and buckets.
+ */
+
+size_t stringBytes(const std::string &text);
+
+size_t treeBytes(size_t count, size_t value);
+
+size_t hashBytes(size_t count, size_t buckets, size_t value);
+
+/*
+ * Function: vectorBytes
+ * Usage: size_t bytes = vectorBytes(values);
+ * ------------------------------------------
+ * Returns the storage reserved by a vector, not counting any heap
+ * storage of its elements.
+ */
+
+template <typename T>
+size_t vectorBytes(const std::vector<T> &values) {
+    return values.capacity() * sizeof(T);
+}
+
+#endif
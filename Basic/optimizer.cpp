@@ -0,0 +1,298 @@
+/*
+ * File: optimizer.cpp
+ * -------------------
+ * Implements the optimizer.h interface.
+ */
+
+#include <map>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "optimizer.hpp"
+#include "compiled.hpp"
+#include "statement.hpp"
+#include "exptable.hpp"
+
+/*
+ * Implementation notes: value numbering
+ * -------------------------------------
+ * Constants and variables are numbered by their value and symbol, and
+ * a compound subexpression by its operator, the numbers of its operands
+ * and the number of assignments evaluated before it, so two
+ * subexpressions get the same number exactly when they have the same
+ * structure and no assignment separates them.  The expressions are
+ * walked twice in evaluation order: the first walk numbers the compound
+ * subexpressions without assignments and counts the occurrences of each
+ * number, and the second replaces the numbers seen at least twice.  The
+ * first occurrence in evaluation order keeps its subtree and the later
+ * ones free theirs, which is safe because every operand of a compound
+ * expression is always evaluated.
+ */
+
+static bool containsAssignment(Expression *exp) {
+    if (exp->getType() != COMPOUND) return false;
+    CompoundExp *compound = (CompoundExp *) exp;
+    if (compound->getOp() == "=") return true;
+    return containsAssignment(compound->getLHS()) || containsAssignment(compound->getRHS());
+}
+
+struct ValueNumbers {
+    //(种类或运算符, 值或左右操作数的编号, 之前的赋值个数)->编号。
+    std::map<std::tuple<char, int, int, int>, int> numbers;
+    //编号->出现次数。
+    std::vector<int> counts;
+    //不含赋值的复合子表达式->编号。
+    std::unordered_map<Expression *, int> nodes;
+
+    int number(char kind, int first, int second, int barrier) {
+        auto iter = numbers.emplace(std::make_tuple(kind, first, second, barrier), (int) counts.size()).first;
+        if ((*iter).second == (int) counts.size()) counts.push_back(0);
+        return (*iter).second;
+    }
+};
+
+static int countValues(Expression *exp, int &barrier, ValueNumbers &values) {
+    switch (exp->getType()) {
+    case CONSTANT:
+        return values.number('c', ((ConstantExp *) exp)->getValue(), 0, 0);
+    case IDENTIFIER:
+        return values.number('i', ((IdentifierExp *) exp)->getSymbol(), 0, 0);
+    case COMPOUND:
+        break;
+    default:
+        return values.number('?', (int) values.counts.size(), 0, 0);
+    }
+    CompoundExp *compound = (CompoundExp *) exp;
+    if (compound->getOp() == "=") {
+        countValues(compound->getRHS(), barrier, values);
+        ++barrier;
+        return values.number('?', (int) values.counts.size(), 0, 0);
+    }
+    int before = barrier;
+    int lhs = countValues(compound->getLHS(), barrier, values);
+    int rhs = countValues(compound->getRHS(), barrier, values);
+    if (barrier != before) return values.number('?', (int) values.counts.size(), 0, 0);
+    int number = values.number(compound->getOp()[0], lhs, rhs, barrier);
+    ++values.counts[number];
+    values.nodes[exp] = number;
+    return number;
+}
+
+struct SharedValue {
+    int slot;
+    Expression *exp;
+};
+
+static Expression *replaceValues(Expression *exp, ValueNumbers &values, std::map<int, SharedValue> &shared) {
+    if (exp->getType() != COMPOUND) return exp;
+    CompoundExp *compound = (CompoundExp *) exp;
+    auto node = values.nodes.find(exp);
+    if (node != values.nodes.end() && values.counts[(*node).second] >= 2) {
+        int number = (*node).second;
+        auto iter = shared.find(number);
+        if (iter != shared.end()) {
+            delete exp;
+            return new SharedExp(iter->second.slot, iter->second.exp, false);
+        }
+        int slot = (int) shared.size();
+        shared[number] = SharedValue{slot, exp};
+        compound->setLHS(replaceValues(compound->getLHS(), values, shared));
+        compound->setRHS(replaceValues(compound->getRHS(), values, shared));
+        return new SharedExp(slot, exp, true);
+    }
+    compound->setLHS(replaceValues(compound->getLHS(), values, shared));
+    compound->setRHS(replaceValues(compound->getRHS(), values, shared));
+    return exp;
+}
+
+int shareSubexpressions(const std::vector<Expression **> &roots) {
+    ValueNumbers values;
+    int barrier = 0;
+    for (Expression **root : roots) {
+        countValues(*root, barrier, values);
+    }
+    std::map<int, SharedValue> shared;
+    for (Expression **root : roots) {
+        *root = replaceValues(*root, values, shared);
+    }
+    return (int) shared.size();
+}
+
+/*
+ * Implementation notes: loop-invariant code motion
+ * ------------------------------------------------
+ * A subexpression cannot be evaluated before the loop is entered,
+ * since that would report errors, such as an undefined variable or a
+ * division by zero, on paths that never evaluated it.  Instead, each
+ * HoistedExp computes its value the first time it is evaluated after
+ * the loop is entered and keeps it until control enters the loop again.
+ * Assignments inside expressions never appear in hoisted subtrees, and
+ * shared occurrences are walked only through the node that owns them.
+ */
+
+static void collectAssigned(Expression *exp, std::set<int> &assigned) {
+    if (exp->getType() != COMPOUND) return;
+    CompoundExp *compound = (CompoundExp *) exp;
+    if (compound->getOp() == "=") {
+        assigned.insert(((IdentifierExp *) compound->getLHS())->getSymbol());
+    }
+    else {
+        collectAssigned(compound->getLHS(), assigned);
+    }
+    collectAssigned(compound->getRHS(), assigned);
+}
+
+static bool isInvariant(Expression *exp, const std::set<int> &assigned) {
+    switch (exp->getType()) {
+    case CONSTANT:
+    case HOISTED:
+        return true;
+    case IDENTIFIER:
+        return assigned.count(((IdentifierExp *) exp)->getSymbol()) == 0;
+    case SHARED:
+        return isInvariant(((SharedExp *) exp)->getExp(), assigned);
+    case POOLED:
+        return isInvariant(((PooledExp *) exp)->getExp(), assigned);
+    case FLAT:
+        return false;
+    case COMPOUND: {
+        CompoundExp *compound = (CompoundExp *) exp;
+        return compound->getOp() != "=" && isInvariant(compound->getLHS(), assigned)
+               && isInvariant(compound->getRHS(), assigned);
+    }
+    }
+    return false;
+}
+
+static Expression *hoist(Expression *exp, int loop, const std::set<int> &assigned, int &slots) {
+    ExpressionType type = exp->getType();
+    if (type == COMPOUND || type == SHARED) {
+        if (isInvariant(exp, assigned)) return new HoistedExp(loop, slots++, exp);
+        CompoundExp *compound = nullptr;
+        if (type == COMPOUND) compound = (CompoundExp *) exp;
+        else if (((SharedExp *) exp)->isOwner()) compound = (CompoundExp *) ((SharedExp *) exp)->getExp();
+        if (compound != nullptr) {
+            compound->setLHS(hoist(compound->getLHS(), loop, assigned, slots));
+            compound->setRHS(hoist(compound->getRHS(), loop, assigned, slots));
+        }
+    }
+    return exp;
+}
+
+int hoistInvariants(const CompiledProgram &program, const FlowGraph &flow) {
+    int slots = 0;
+    for (int loop = 0; loop < flow.countLoops(); ++loop) {
+        std::set<int> assigned;
+        for (int line : flow.getLoopBody(loop)) {
+            Statement *stmt = program.getParsedStatement(line);
+            if (stmt->getType() == INPUT_STMT) {
+                assigned.insert(((Sequential *) stmt)->getVariable());
+            }
+            if (stmt->getType() == PARALLEL_STMT) {
+                for (int variable : ((PARALLEL *) stmt)->getAssigned()) {
+                    assigned.insert(variable);
+                }
+            }
+            for (Expression **root : stmt->getExpressions()) {
+                collectAssigned(*root, assigned);
+            }
+        }
+        for (int line : flow.getLoopBody(loop)) {
+            for (Expression **root : program.getParsedStatement(line)->getExpressions()) {
+                *root = hoist(*root, loop, assigned, slots);
+            }
+        }
+    }
+    return slots;
+}
+
+/*
+ * Implementation notes: counted loops
+ * -----------------------------------
+ * The patterns are matched on the parsed trees after hoisting, which
+ * leaves the increment alone since I is assigned in the loop.  The
+ * bound may be any expression without assignments: the IF evaluates it
+ * after the increment either way, and with no assignment inside it the
+ * value of I cannot change while it is evaluated.
+ */
+
+static bool matchIncrement(Statement *stmt, int &variable, int &step) {
+    if (stmt->getType() != LET_STMT) return false;
+    Expression *exp = *stmt->getExpressions()[0];
+    if (exp->getType() != COMPOUND || ((CompoundExp *) exp)->getOp() != "=") return false;
+    Expression *target = ((CompoundExp *) exp)->getLHS();
+    Expression *value = ((CompoundExp *) exp)->getRHS();
+    if (target->getType() != IDENTIFIER || value->getType() != COMPOUND) return false;
+    variable = ((IdentifierExp *) target)->getSymbol();
+    CompoundExp *sum = (CompoundExp *) value;
+    Expression *lhs = sum->getLHS();
+    Expression *rhs = sum->getRHS();
+    bool lhsVariable = lhs->getType() == IDENTIFIER && ((IdentifierExp *) lhs)->getSymbol() == variable;
+    bool rhsVariable = rhs->getType() == IDENTIFIER && ((IdentifierExp *) rhs)->getSymbol() == variable;
+    if (sum->getOp() == "+" && lhsVariable && rhs->getType() == CONSTANT) {
+        step = ((ConstantExp *) rhs)->getValue();
+        return true;
+    }
+    if (sum->getOp() == "+" && rhsVariable && lhs->getType() == CONSTANT) {
+        step = ((ConstantExp *) lhs)->getValue();
+        return true;
+    }
+    if (sum->getOp() == "-" && lhsVariable && rhs->getType() == CONSTANT) {
+        step = (int) (0u - (unsigned) ((ConstantExp *) rhs)->getValue());
+        return true;
+    }
+    return false;
+}
+
+std::map<int, std::unique_ptr<Statement>> fuseCountedLoops(const CompiledProgram &program, const FlowGraph &flow) {
+    std::map<int, std::unique_ptr<Statement>> fused;
+    for (int line = program.getFirstLineNumber(); line != -1; line = program.getNextLineNumber(line)) {
+        int next = program.getNextLineNumber(line);
+        if (next == -1) break;
+        int variable;
+        int step;
+        if (!matchIncrement(program.getParsedStatement(line), variable, step)) continue;
+        Statement *stmt = program.getParsedStatement(next);
+        if (stmt->getType() != IF_STMT || flow.findLoop(next) != -1) continue;
+        IF *branch = (IF *) stmt;
+        if (branch->getTarget() >= next) continue;
+        Expression *lhs = branch->getLHS();
+        Expression *rhs = branch->getRHS();
+        bool lhsVariable = lhs->getType() == IDENTIFIER && ((IdentifierExp *) lhs)->getSymbol() == variable;
+        bool rhsVariable = rhs->getType() == IDENTIFIER && ((IdentifierExp *) rhs)->getSymbol() == variable;
+        if (lhsVariable && !containsAssignment(rhs)) {
+            fused[line].reset(new CountedLoop(variable, step, next, branch->getExpressions()[1], false,
+                                              branch->getCompare(), branch->getTarget()));
+        }
+        else if (rhsVariable && !containsAssignment(lhs)) {
+            fused[line].reset(new CountedLoop(variable, step, next, branch->getExpressions()[0], true,
+                                              branch->getCompare(), branch->getTarget()));
+        }
+    }
+    return fused;
+}
+
+/*
+ * Implementation notes: flattenExpressions
+ * ----------------------------------------
+ * All roots are added to the table before any tree is freed, since
+ * the table recognizes the parts it has already added by their
+ * addresses, and shared occurrences refer into trees of other roots of
+ * the same statement.
+ */
+
+void flattenExpressions(const CompiledProgram &program, ExpressionTable &table) {
+    std::vector<std::pair<Expression **, int>> roots;
+    for (int line = program.getFirstLineNumber(); line != -1; line = program.getNextLineNumber(line)) {
+        for (Expression **root : program.getParsedStatement(line)->getExpressions()) {
+            roots.push_back({root, table.add(*root)});
+        }
+    }
+    table.finish();
+    for (auto &root : roots) {
+        Expression *tree = *root.first;
+        *root.first = new FlatExp(table, root.second);
+        delete tree;
+    }
+}
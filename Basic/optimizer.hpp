@@ -0,0 +1,81 @@
+/*
+ * File: optimizer.h
+ * -----------------
+ * This interface exports the passes that rewrite parsed expressions
+ * into equivalent forms that are cheaper to evaluate.  The passes
+ * never change the value a statement computes, the order in which
+ * its assignments happen, or the errors it reports.
+ */
+
+#ifndef _optimizer_h
+#define _optimizer_h
+
+#include <vector>
+#include <map>
+#include <memory>
+#include "exp.hpp"
+#include "flowgraph.hpp"
+
+class CompiledProgram;
+class ExpressionTable;
+class Statement;
+
+/*
+ * Function: shareSubexpressions
+ * Usage: int slots = shareSubexpressions({ &lhs, &rhs });
+ * -------------------------------------------------------
+ * Performs local value numbering over the expressions of a single
+ * statement, given in the order in which the statement evaluates them.
+ * Every compound subexpression that occurs more than once and contains
+ * no assignment is replaced by SharedExp nodes naming one temporary
+ * slot, so that it is computed only once per execution.  An assignment
+ * acts as a barrier: occurrences on either side of it are numbered
+ * separately.  The function returns the number of slots it allocated.
+ */
+
+int shareSubexpressions(const std::vector<Expression **> &roots);
+
+/*
+ * Function: hoistInvariants
+ * Usage: int slots = hoistInvariants(program, flow);
+ * --------------------------------------------------
+ * Performs loop-invariant code motion over the loops of the program
+ * described by flow.  Every maximal compound subexpression in a loop
+ * body whose variables are not assigned anywhere in that body, either
+ * by LET, by INPUT, by a PARALLEL FOR or by an assignment inside an
+ * expression, is wrapped in a HoistedExp.  Loops are processed from the outermost
+ * inwards, so each expression is hoisted as far out as possible.  The
+ * function returns the number of slots it allocated.
+ */
+
+int hoistInvariants(const CompiledProgram &program, const FlowGraph &flow);
+
+/*
+ * Function: fuseCountedLoops
+ * Usage: std::map<int, std::unique_ptr<Statement>> fused = fuseCountedLoops(program, flow);
+ * -----------------------------------------------------------------------------------------
+ * Finds the lines of the form LET I = I + c (or I - c, or c + I, with
+ * c a constant) immediately followed by an IF that compares I against
+ * an expression without assignments and branches back to an earlier
+ * line, and returns a CountedLoop for each of them keyed by the line
+ * number of the LET.  The IF line must not be a loop header, since the
+ * fused statement enters it without passing the loop-entry check.  The
+ * caller owns the returned statements; they must be rebuilt whenever
+ * the program changes.  A CountedLoop reads its bound through the root
+ * of the IF, so it follows the IF when that root is replaced.
+ */
+
+std::map<int, std::unique_ptr<Statement>> fuseCountedLoops(const CompiledProgram &program, const FlowGraph &flow);
+
+/*
+ * Function: flattenExpressions
+ * Usage: flattenExpressions(program, table);
+ * ------------------------------------------
+ * Adds the expressions of every statement of program to table and
+ * replaces each root by a FlatExp for its node, freeing the trees.
+ * This must be the last pass, since the others work on the trees.
+ */
+
+void flattenExpressions(const CompiledProgram &program, ExpressionTable &table);
+
+#endif
@@ -4,6 +4,7 @@
  * Implements the parser.h interface.
  */
 
+#include <memory>
 #include "parser.hpp"
 
 
@@ -11,14 +12,16 @@
  * Implementation notes: parseExp
  * ------------------------------
  * This code just reads an expression and then checks for extra tokens.
+ * Here and in the functions below, the parts read so far are held by
+ * a unique_ptr until they are returned, so an error frees them.
  */
 
 Expression *parseExp(TokenScanner &scanner) {
-    Expression *exp = readE(scanner);
+    std::unique_ptr<Expression> exp(readE(scanner));
     if (scanner.hasMoreTokens()) {
         error("parseExp: Found extra token: " + scanner.nextToken());
     }
-    return exp;
+    return exp.release();
 }
 
 /*
@@ -33,17 +36,17 @@ Expression *parseExp(TokenScanner &scanner) {
  */
 
 Expression *readE(TokenScanner &scanner, int prec) {
-    Expression *exp = readT(scanner);
+    std::unique_ptr<Expression> exp(readT(scanner));
     std::string token;
     while (true) {
         token = scanner.nextToken();
         int newPrec = precedence(token);
         if (newPrec <= prec) break;
         Expression *rhs = readE(scanner, newPrec);
-        exp = new CompoundExp(token, exp, rhs);
+        exp.reset(new CompoundExp(token, exp.release(), rhs));
     }
     scanner.saveToken(token);
-    return exp;
+    return exp.release();
 }
 
 /*
@@ -58,13 +61,16 @@ Expression *readT(TokenScanner &scanner) {
     TokenType type = scanner.getTokenType(token);
     if (type == WORD) return new IdentifierExp(token);
     if (type == NUMBER) return new ConstantExp(stringToInteger(token));
-    if (token == "-") return new CompoundExp(token, new ConstantExp(0), readE(scanner));
+    if (token == "-") {
+        Expression *rhs = readE(scanner);
+        return new CompoundExp(token, new ConstantExp(0), rhs);
+    }
     if (token != "(") error("Illegal term in expression");
-    Expression *exp = readE(scanner);
+    std::unique_ptr<Expression> exp(readE(scanner));
     if (scanner.nextToken() != ")") {
         error("Unbalanced parentheses in expression");
     }
-    return exp;
+    return exp.release();
 }
 
 /*
@@ -80,3 +86,30 @@ int precedence(std::string token) {
     if (token == "*" || token == "/") return 3;
     return 0;
 }
+
+/*
+ * Implementation notes: checkAssignments
+ * --------------------------------------
+ * The evaluator checks the target of an assignment before it evaluates
+ * the right-hand side and never evaluates the left one, so the checks
+ * follow the same order.  Shared and hoisted subexpressions never
+ * contain assignments and need not be visited.
+ */
+
+void checkAssignments(Expression *exp) {
+    if (exp->getType() != COMPOUND) return;
+    CompoundExp *compound = (CompoundExp *) exp;
+    if (compound->getOp() == "=") {
+        Expression *lhs = compound->getLHS();
+        if (lhs->getType() != IDENTIFIER) {
+            error("Illegal variable in assignment");
+        }
+        if (lhs->toString() == "LET") {
+            error("SYNTAX ERROR");
+        }
+    }
+    else {
+        checkAssignments(compound->getLHS());
+    }
+    checkAssignments(compound->getRHS());
+}
@@ -58,4 +58,15 @@ Expression *readT(TokenScanner &scanner);
 
 int precedence(std::string token);
 
+/*
+ * Function: checkAssignments
+ * Usage: checkAssignments(exp);
+ * -----------------------------
+ * Checks every assignment that evaluating exp would perform, in the
+ * order in which the evaluator reaches them, and raises an error for
+ * the first one whose target is not a variable or is named LET.
+ */
+
+void checkAssignments(Expression *exp);
+
 #endif
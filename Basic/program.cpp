@@ -8,50 +8,102 @@
  * the performance guarantees specified in the assignment.
  */
 
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <streambuf>
 #include "program.hpp"
 #include "evalstate.hpp"
+#include "imagecache.hpp"
+#include "interpreter.hpp"
+#include "journal.hpp"
+#include "symbols.hpp"
 
 class Program;
 class Statement;
 
+/*
+ * Class: OutputLimit
+ * ------------------
+ * A stream that passes at most a given number of bytes on to another
+ * stream and drops the rest, remembering that it did so.  It has no
+ * buffer of its own, so what is written reaches the other stream at
+ * once and in order with the output of code that writes there directly.
+ */
+
+class OutputLimit : public std::streambuf {
+public:
+    OutputLimit(std::ostream &target, long limit) : target(target), stream(this), left(limit) {
+    }
+
+    std::ostream &getStream() {
+        return stream;
+    }
+
+    bool isExceeded() const {
+        return exceeded;
+    }
+
+protected:
+    virtual int_type overflow(int_type ch) {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+        char c = traits_type::to_char_type(ch);
+        xsputn(&c, 1);
+        return ch;
+    }
+
+    virtual std::streamsize xsputn(const char *s, std::streamsize n) {
+        std::streamsize take = std::min<std::streamsize>(n, left);
+        if (take < n) exceeded = true;
+        left -= take;
+        target.write(s, take);
+        return n;
+    }
+
+    virtual int sync() {
+        target.flush();
+        return 0;
+    }
+
+private:
+    std::ostream &target;
+    std::ostream stream;
+    long left;
+    bool exceeded = false;
+};
+
 Program::Program() = default;
 
 Program::~Program() = default;
 
 // Removes all lines from the program.
 void Program::clear(EvalState& state) {
-    max_line = 0;
-    pointer = 0;
+    if (journal_ != nullptr) journal_->clear();
     line_numbers_.clear();
     storage.clear();
-    for(auto iter=ram.begin();iter!=ram.end();++iter){
-        (*iter).second->kill();
-        delete (*iter).second;
-    }
-    ram.clear();
+    ready_.reset();
+    invalidate_();
+    ran_ = false;
     state.Clear();
 }
 
-void Program::addSourceLine(int lineNumber, const std::string &line, Statement& info) {
-    auto iter = line_numbers_.find(lineNumber);
-    if (iter == line_numbers_.end()) {
-        line_numbers_.insert(lineNumber);
-        storage[lineNumber] = line;
-        ram[lineNumber] = &(info);
-    }
-    else {
-        setParsedStatement(lineNumber, info);
-        storage[lineNumber] = line;
-    }
+void Program::addSourceLine(int lineNumber, const std::string &line, std::unique_ptr<Statement> info) {
+    if (journal_ != nullptr) journal_->add(lineNumber, line, info.get());
+    if (sharing_) pool_->share(info->getExpressions());
+    invalidate_();
+    auto iter = line_numbers_.insert(lineNumber).first;
+    storage.set(lineNumber, line);
+    int previous = iter == line_numbers_.begin() ? -1 : *std::prev(iter);
+    edit_ready_().set(lineNumber, previous, std::move(info));
 }
 
 void Program::removeSourceLine(int lineNumber) {
     if(line_numbers_.find(lineNumber)!=line_numbers_.end()){
+        if (journal_ != nullptr) journal_->remove(lineNumber);
+        invalidate_();
         line_numbers_.erase(lineNumber);
-        storage.erase(lineNumber);
-        ram[lineNumber]->kill();
-        delete ram[lineNumber];
-        ram.erase(lineNumber);
+        storage.remove(lineNumber);
+        edit_ready_().remove(lineNumber);
     }
     else{
         return;
@@ -59,35 +111,23 @@ void Program::removeSourceLine(int lineNumber) {
 }
 
 std::string Program::getSourceLine(int lineNumber) {
-    std::string object = "\0";
-    auto iter = storage.find(lineNumber);
-    if (iter != storage.end()) {
-        object = (*iter).second;
-    }
-    return object;
+    return storage.get(lineNumber);
 }
 
-void Program::setParsedStatement(int lineNumber, Statement& new_info) {
-    auto iter = ram.find(lineNumber);
-    if (iter != ram.end()) {
-        (*iter).second->kill();
-        delete (*iter).second;
-        (*iter).second = &new_info;
-    }
-    else {
+void Program::setParsedStatement(int lineNumber, std::unique_ptr<Statement> new_info) {
+    if (line_numbers_.find(lineNumber) == line_numbers_.end()) {
         error("SYNTAX ERROR");
     }
+    if (journal_ != nullptr) journal_->add(lineNumber, storage.get(lineNumber), new_info.get());
+    if (sharing_) pool_->share(new_info->getExpressions());
+    invalidate_();
+    edit_ready_().set(lineNumber, -1, std::move(new_info));
 }
 
 
 Statement* Program::getParsedStatement(int lineNumber) {
-    auto iter = ram.find(lineNumber);
-    if (iter != ram.end()) {
-        return (*iter).second;
-    }
-    else {
-        return nullptr;
-    }
+    int slot = ready_ ? ready_->find(lineNumber) : -1;
+    return slot == -1 ? nullptr : ready_->getCode(slot);
 }
 
 //Returns the line number of the first line in the program.
@@ -127,42 +167,421 @@ int Program::getNextLineNumber(int lineNumber) {
     }
 }
 
-void Program::list_program_() {
+void Program::list_program_(std::ostream& out) {
     if (Program::getFirstLineNumber() != -1) {
         for (auto iter = line_numbers_.begin();iter != line_numbers_.end();++iter) {
-            std::cout << (*iter) << ' ' << storage[(*iter)] << '\n';
+            out << (*iter) << ' ';
+            storage.write(*iter, out);
+            out << '\n';
         }
     }
     return;
 }
 
 void Program::run_program_(EvalState& eval) {
-    pointer = Program::getFirstLineNumber();
-    max_line = Program::getLastLineNumber();
-    while (pointer != -1) {
-        int memory_now = pointer;
-        (*ram[pointer]).execute(eval,*this);
-        if (pointer == memory_now) {
-            pointer = getNextLineNumber(pointer);
-            continue;
+    if (!image_ && !use_ready_()) {
+        prepare_();
+    }
+    if (image_ && precompute_budget_ > 0 && !limits_.isLimited() && image_->isInputFree() && !image_->hasParallel()) {
+        if (!precomputed_.valid && precompute_(eval)) {
+            return;
+        }
+        if (precomputed_.valid) {
+            eval.getOutput() << precomputed_.output;
+            for (auto &variable : precomputed_.final.getVariables()) {
+                eval.setValue(variable.first, variable.second);
+            }
+            if (precomputed_.failed) {
+                error(precomputed_.message);
+            }
+            return;
         }
     }
-    return;
+    begin_run_(eval);
+    resume_run_(eval, -1);
+}
+
+void Program::begin_run_(EvalState& eval) {
+    run_ = Run();
+    if (!image_ && use_ready_()) {
+        run_.ready = ready_;
+        run_.next = ready_->getFirst();
+        run_.pointer = ready_->getLine(run_.next);
+    }
+    else {
+        if (!image_) {
+            prepare_();
+        }
+        run_.image = image_;
+        run_.pointer = image_->getFirstLineNumber();
+    }
+    ran_ = true;
+    edited_ = false;
+    run_.running = true;
+    run_.limits = limits_;
+    if (limits_.statements > 0) {
+        run_.shared = std::make_shared<std::atomic<long>>(0);
+    }
+    if (limits_.milliseconds > 0) {
+        run_.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(limits_.milliseconds);
+    }
+    if (limits_.output > 0) {
+        run_.output = std::make_shared<OutputLimit>(eval.getOutput(), limits_.output);
+    }
+}
+
+/*
+ * Implementation notes: resume_run_
+ * ---------------------------------
+ * All the state of a run between two calls lives in run_, so stopping
+ * is just a matter of returning.  An INPUT that finds no line leaves
+ * the pointer unchanged, and it is executed again when the run
+ * resumes.  The run holds its own reference to the version or the
+ * ReadyImage it executes, which is dropped when the run ends; an edit
+ * during the run copies the image instead of changing it.  On a
+ * ReadyImage, the run follows the slots: set_pointer takes the target
+ * slot recorded for the jump being executed, and only looks the line
+ * up when the statement names another line.
+ *
+ * Without a jump back to an earlier line a run can execute each line
+ * at most once, so checking the limits at such jumps and at the end
+ * bounds every run while keeping the checks off the straight path.
+ * The statements counted in run_ are added to the counter the run
+ * shares with the bodies of its PARALLEL FOR loops only when the
+ * limits are checked, so counting stays a plain increment.
+ * While the output is limited, the state writes to the counting stream
+ * of the run for as long as this method executes.  The steps a
+ * statement reports through count_steps_, the second line of a fused
+ * pair or the iterations of a PARALLEL FOR, are counted as executed
+ * and taken off the steps left once it returns, so neither the limits
+ * nor a slice depend on how the lines were grouped.
+ */
+
+RunStatus Program::resume_run_(EvalState& eval, long steps) {
+    if (!run_.running) {
+        return RUN_FINISHED;
+    }
+    const CompiledProgram *image = run_.image.get();
+    const ReadyImage *ready = run_.ready.get();
+    bool loops = image && image->getFlowGraph().countLoops() != 0;
+    bool limited = run_.limits.isLimited();
+    struct Redirect {
+        EvalState &eval;
+        std::ostream &out;
+        ~Redirect() {
+            eval.setOutput(out);
+        }
+    } redirect{eval, eval.getOutput()};
+    if (run_.output) {
+        eval.setOutput(run_.output->getStream());
+    }
+    try {
+        while (run_.pointer != -1 && run_.pointer != run_.stop) {
+            if (steps >= 0 && steps-- == 0) {
+                return RUN_PREEMPTED;
+            }
+            //从循环外进入循环头时，使该循环外提的值失效。
+            if (loops) {
+                const FlowGraph &flow = image->getFlowGraph();
+                int loop = flow.findLoop(run_.pointer);
+                if (loop != -1 && !flow.inLoop(loop, run_.previous)) {
+                    eval.enterLoop(loop);
+                }
+            }
+            run_.current = run_.pointer;
+            ++run_.executed;
+            Statement *stmt;
+            if (ready) {
+                run_.slot = run_.next;
+                stmt = ready->getCode(run_.slot);
+            }
+            else {
+                stmt = image->getCode(run_.pointer);
+            }
+            stmt->execute(eval,*this);
+            if (run_.counted != 0) {
+                run_.executed += run_.counted;
+                if (steps > 0) steps -= std::min(steps, run_.counted);
+                run_.counted = 0;
+            }
+            if (eval.isWaitingForInput()) {
+                --run_.executed;
+                return RUN_WAITING;
+            }
+            run_.previous = run_.current;
+            if (run_.pointer == run_.current) {
+                if (ready) {
+                    run_.next = ready->getNext(run_.slot);
+                    run_.pointer = ready->getLine(run_.next);
+                }
+                else {
+                    run_.pointer = image->getNextLineNumber(run_.pointer);
+                }
+                continue;
+            }
+            if (limited && run_.pointer != -1 && run_.pointer < run_.current) {
+                check_limits_(eval);
+            }
+        }
+        if (limited) {
+            check_limits_(eval);
+        }
+    }
+    catch (...) {
+        run_ = Run();
+        throw;
+    }
+    run_ = Run();
+    return RUN_FINISHED;
+}
+
+void Program::run_loop_(EvalState& eval, int variable, int first, int last, int from, int to) {
+    Program body;
+    for (int value = first; ; ++value) {
+        eval.setValue(variable, value);
+        body.run_ = Run();
+        body.run_.image = run_.image;
+        body.run_.pointer = run_.image->getNextLineNumber(from);
+        body.run_.previous = from;
+        body.run_.stop = to;
+        body.run_.running = true;
+        body.run_.limits = run_.limits;
+        body.run_.shared = run_.shared;
+        body.run_.deadline = run_.deadline;
+        body.run_.output = run_.output;
+        body.resume_run_(eval, -1);
+        if (value == last) break;
+    }
+}
+
+void Program::check_limits_(EvalState& eval) {
+    const RunLimits &limits = run_.limits;
+    if (limits.statements > 0) {
+        long executed = run_.shared->fetch_add(run_.executed) + run_.executed;
+        run_.executed = 0;
+        if (executed > limits.statements) error("STATEMENT LIMIT EXCEEDED");
+    }
+    if (limits.milliseconds > 0 && std::chrono::steady_clock::now() > run_.deadline) {
+        error("TIME LIMIT EXCEEDED");
+    }
+    if (limits.variables > 0 && eval.getVariableCount() > limits.variables) {
+        error("VARIABLE LIMIT EXCEEDED");
+    }
+    if (run_.output && run_.output->isExceeded()) {
+        error("OUTPUT LIMIT EXCEEDED");
+    }
+}
+
+bool Program::is_running_() {
+    return run_.running;
+}
+
+/*
+ * Implementation notes: prepare_
+ * ------------------------------
+ * The text of the lines determines the parsed statements, so versions
+ * are shared under it.  A new version needs statements of its own,
+ * since compiling rewrites them, while those of the ReadyImage must
+ * stay as parsed and those of the previous version may still be
+ * running.  They are copied from the ReadyImage through the code of
+ * the image cache, which rebuilds a statement without tokenizing or
+ * parsing its text.  If the version cannot be built, its statements
+ * are freed with it.
+ */
+
+void Program::prepare_() {
+    image_ = CompiledProgram::find(storage);
+    if (!image_) {
+        std::map<int, std::unique_ptr<Statement>> lines;
+        std::string code;
+        for (int slot = ready_ ? ready_->getFirst() : -1; slot != -1; slot = ready_->getNext(slot)) {
+            code.clear();
+            writeStatement(code, ready_->getCode(slot));
+            lines.emplace_hint(lines.end(), ready_->getLine(slot), readStatement(code.data(), code.data() + code.size()));
+        }
+        image_ = CompiledProgram::publish(std::make_shared<const CompiledProgram>(std::move(lines), storage));
+    }
+}
+
+ReadyImage& Program::edit_ready_() {
+    if (!ready_) {
+        ready_ = std::make_shared<ReadyImage>();
+    }
+    else if (ready_.use_count() > 1) {
+        ready_ = std::make_shared<ReadyImage>(*ready_);
+    }
+    return *ready_;
+}
+
+bool Program::use_ready_() {
+    return ran_ && edited_ && ready_ && !ready_->hasParallel()
+           && (precompute_budget_ == 0 || limits_.isLimited());
+}
+
+void Program::invalidate_() {
+    image_.reset();
+    edited_ = true;
+    precomputed_ = Precomputed();
+}
+
+std::shared_ptr<const CompiledProgram> Program::getCompiledProgram() {
+    if (!image_) {
+        prepare_();
+    }
+    return image_;
+}
+
+void Program::setRunLimits(const RunLimits &limits) {
+    limits_ = limits;
+}
+
+/*
+ * Implementation notes: getMemoryStats
+ * ------------------------------------
+ * The result of a precomputed run is a set of variables and the
+ * output, so it counts with the variables.
+ */
+
+MemoryStats Program::getMemoryStats(const EvalState& state) {
+    MemoryStats stats;
+    stats.source = storage.getBytes();
+    stats.lines = treeBytes(line_numbers_.size(), sizeof(int));
+    if (ready_) {
+        ready_->measure(stats);
+    }
+    if (image_) {
+        image_->measure(stats);
+    }
+    if (pool_) {
+        pool_->measure(stats);
+    }
+    stats.symbols = getSymbolBytes();
+    stats.variables = state.getBytes();
+    if (precomputed_.valid) {
+        stats.variables += precomputed_.final.getBytes() + stringBytes(precomputed_.output) + stringBytes(precomputed_.message);
+    }
+    return stats;
+}
+
+void Program::list_memory_(const EvalState& state, std::ostream& out) {
+    MemoryStats stats = getMemoryStats(state);
+    out << "SOURCE " << stats.source << '\n'
+        << "LINES " << stats.lines << '\n'
+        << "STATEMENTS " << stats.statements << '\n'
+        << "EXPRESSIONS " << stats.expressions << '\n'
+        << "SYMBOLS " << stats.symbols << '\n'
+        << "VARIABLES " << stats.variables << '\n'
+        << "TOTAL " << stats.total() << '\n';
+}
+
+void Program::setJournal(EditJournal* journal) {
+    journal_ = journal;
+}
+
+void Program::setExpressionSharing(bool enabled) {
+    if (enabled && !pool_) pool_.reset(new ExpressionPool());
+    sharing_ = enabled;
+}
+
+void Program::setPrecomputeBudget(long steps) {
+    precompute_budget_ = steps;
+    precomputed_ = Precomputed();
+}
+
+/*
+ * Implementation notes: precompute_
+ * ---------------------------------
+ * The program runs on a fresh state, with its output collected in a
+ * string.  Every variable it reads without failing was assigned by the
+ * run itself, so up to any point the run is the one that eval would
+ * see, apart from the variables of eval it has not assigned.  A run
+ * that stops with another error than an undefined variable is
+ * remembered as well, so that replaying it prints the same output
+ * followed by the same message.
+ *
+ * When the budget runs out, the variables of eval the run has not
+ * assigned are added to its state, which is the state of the real run
+ * at that point, and the run carries on with the output going to eval,
+ * so the statements already executed are not executed again.
+ */
+
+bool Program::precompute_(EvalState& eval) {
+    if (precomputed_.exhausted) {
+        return false;
+    }
+    Precomputed result;
+    std::ostringstream out;
+    result.final.setOutput(out);
+    bool finished = true;
+    try {
+        begin_run_(result.final);
+        finished = resume_run_(result.final, precompute_budget_) == RUN_FINISHED;
+    }
+    catch (ErrorException &ex) {
+        if (ex.getMessage() == "VARIABLE NOT DEFINED") {
+            precomputed_.exhausted = true;
+            return false;
+        }
+        result.failed = true;
+        result.message = ex.getMessage();
+    }
+    if (!finished) {
+        precomputed_.exhausted = true;
+        eval.getOutput() << out.str();
+        for (auto &variable : eval.getVariables()) {
+            if (!result.final.isDefined(variable.first)) {
+                result.final.setValue(variable.first, variable.second);
+            }
+        }
+        result.final.setOutput(eval.getOutput());
+        try {
+            resume_run_(result.final, -1);
+        }
+        catch (...) {
+            eval.copyVariables(result.final);
+            throw;
+        }
+        eval.copyVariables(result.final);
+        return true;
+    }
+    result.final.setOutput(std::cout);
+    result.output = out.str();
+    result.valid = true;
+    precomputed_ = result;
+    return false;
+}
+
+void Program::count_steps_(long steps) {
+    run_.counted += steps;
+}
+
+void Program::fall_to(int object) {
+    run_.pointer = object;
+    run_.current = object;
 }
 
 bool Program::set_pointer(int object) {
     if (object == -1) {
-        pointer = -1;
+        run_.pointer = -1;
         return 1;
     }
-    auto iter = line_numbers_.find(object);
-    if (iter == line_numbers_.end()) {
+    if (run_.ready) {
+        int slot = run_.ready->getTarget(run_.slot);
+        if (run_.ready->getLine(slot) != object) {
+            slot = run_.ready->find(object);
+        }
+        if (slot == -1) {
+            return 0;
+        }
+        run_.next = slot;
+        run_.pointer = object;
+        return 1;
+    }
+    if (!run_.image || !run_.image->hasLine(object)) {
         return 0;
     }
     else {
-        pointer = object;
+        run_.pointer = object;
         return 1;
     }
 }
-
-
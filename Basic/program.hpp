@@ -9,12 +9,56 @@
 #define _program_h
 
 #include <string>
+#include <iostream>
 #include <vector>
 #include <set>
+#include <map>
 #include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <chrono>
 #include "statement.hpp"
+#include "compiled.hpp"
+#include "linestore.hpp"
+#include "readyimage.hpp"
+#include "exppool.hpp"
+#include "memory.hpp"
 
 class Statement;
+class EditJournal;
+
+/*
+ * Type: RunStatus
+ * ---------------
+ * The reason Program::resume_run_ returned: the run has ended, it has
+ * used up its statement allowance, or it is waiting for INPUT.
+ */
+
+enum RunStatus {
+    RUN_FINISHED, RUN_PREEMPTED, RUN_WAITING
+};
+
+/*
+ * Type: RunLimits
+ * ---------------
+ * The most that one RUN may use: statements executed, milliseconds of
+ * wall time since it started, variables defined in the state and bytes
+ * of output.  A limit of zero means no limit.
+ */
+
+struct RunLimits {
+    long statements = 0;
+    long milliseconds = 0;
+    long variables = 0;
+    long output = 0;
+
+    bool isLimited() const {
+        return statements > 0 || milliseconds > 0 || variables > 0 || output > 0;
+    }
+};
+
+class OutputLimit;
+
 /*
  * This class stores the lines in a BASIC program.  Each line
  * in the program is stored in order according to its line number.
@@ -22,10 +66,20 @@ class Statement;
  * components:
  *
  * 1. The source line, which is the complete line (including the
- *    line number) that was entered by the user.
+ *    line number) that was entered by the user.  The text is kept
+ *    tokenized in a LineStore and rebuilt when it is needed.
  *
  * 2. The parsed representation of that statement, which is a
  *    pointer to a Statement.
+ *
+ * RUN executes a CompiledProgram built from the lines, which is shared
+ * with every other Program that has the same text.  The program keeps
+ * using that version until it is edited.  It also keeps a ReadyImage of
+ * the lines, which each edit updates in place, and a RUN that follows
+ * edits made since the previous RUN executes that image instead, so it
+ * starts without compiling the whole program again.  The next RUN of
+ * the unchanged program compiles it.  Programs with PARALLEL FOR, or
+ * whose result may be precomputed, are always compiled.
  */
 
 class Program {
@@ -61,16 +115,17 @@ public:
 
 /*
  * Method: addSourceLine
- * Usage: program.addSourceLine(lineNumber, line);
- * -----------------------------------------------
- * Adds a source line to the program with the specified line number.
- * If that line already exists, the text of the line replaces
+ * Usage: program.addSourceLine(lineNumber, line, std::move(stmt));
+ * ----------------------------------------------------------------
+ * Adds a source line to the program with the specified line number,
+ * together with its parsed representation, which the program takes
+ * over.  If that line already exists, the text of the line replaces
  * the text of any existing line and the parsed representation
  * (if any) is deleted.  If the line is new, it is added to the
  * program in the correct sequence.
  */
 
-    void addSourceLine(int lineNumber, const std::string& line, Statement& info);
+    void addSourceLine(int lineNumber, const std::string& line, std::unique_ptr<Statement> info);
 
 /*
  * Method: removeSourceLine
@@ -96,16 +151,16 @@ public:
 
 /*
  * Method: setParsedStatement
- * Usage: program.setParsedStatement(lineNumber, stmt);
- * ----------------------------------------------------
+ * Usage: program.setParsedStatement(lineNumber, std::move(stmt));
+ * ---------------------------------------------------------------
  * Adds the parsed representation of the statement to the statement
  * at the specified line number.  If no such line exists, this
- * method raises an error.  If a previous parsed representation
- * exists, the memory for that statement is reclaimed.
+ * method raises an error and stmt is freed.  If a previous parsed
+ * representation exists, the memory for that statement is reclaimed.
  */
 
     //更改某行程序。
-    void setParsedStatement(int lineNumber,Statement& stmt);
+    void setParsedStatement(int lineNumber, std::unique_ptr<Statement> stmt);
 
 /*
  * Method: getParsedStatement
@@ -141,21 +196,244 @@ public:
     int getNextLineNumber(int lineNumber);
 
     //依序列出程序
-    void list_program_();
+    void list_program_(std::ostream& out);
 
-    //依序运行程序，直至pointer=-1(end)或 pointer>max_line.
+    //依序运行程序，直至pointer=-1(end)。
     //输入变量库，每条程序的执行可以对变量库进行更改。
+    //state在INPUT处挂起时，可能在等待输入时返回，由resume_run_继续。
     void run_program_(EvalState&);
 
+/*
+ * Methods: begin_run_, resume_run_, is_running_
+ * Usage: program.begin_run_(state);
+ *        RunStatus status = program.resume_run_(state, steps);
+ * ------------------------------------------------------------
+ * Execute the program in slices instead of in one call.  begin_run_
+ * prepares the program and starts a run at its first line, without
+ * executing anything.  resume_run_ executes at most steps statements,
+ * or any number if steps is negative, and returns RUN_PREEMPTED if it
+ * stopped because of that limit, RUN_WAITING if an INPUT found no line
+ * and RUN_FINISHED when the run has ended.  To wait instead of blocking,
+ * the state must be set with setInputSuspends(true); the run continues
+ * after a line is passed to supplyInput and resume_run_ is called
+ * again.  Every line executed counts as a statement, even when two
+ * lines are executed together as one.  A PARALLEL FOR counts as one
+ * statement plus one for each iteration of its body, and since it
+ * cannot stop halfway, the call returns right after it once that uses
+ * up steps.  A run that raises
+ * an error is over, and is_running_ returns false for it.  Editing the
+ * program does not affect a run in progress, which continues on the
+ * version it started with.
+ */
+
+    void begin_run_(EvalState& eval);
+
+    RunStatus resume_run_(EvalState& eval, long steps);
+
+    bool is_running_();
+
+/*
+ * Method: run_loop_
+ * Usage: program.run_loop_(state, variable, first, last, from, to);
+ * -----------------------------------------------------------------
+ * Executes the body of a PARALLEL FOR for each value of the variable
+ * whose symbol is variable, from
+ * first to last: the lines after from are run in the version of the
+ * current run until control reaches the line to.  The body runs with
+ * its own program counter, so several threads may call this method
+ * with different states while the run is stopped at the loop.  The
+ * limits of the run apply to the body as well: its statements count
+ * towards those of the run, and each iteration ends with a check.
+ */
+
+    void run_loop_(EvalState& eval, int variable, int first, int last, int from, int to);
+
     //更改pointer,成功返回1，未成功返回0（包括设置为-1）
     bool set_pointer(int object);
 
+    //融合语句执行到后一行时调用：把pointer与当前行一并移到object，
+    //之后的跳转按object处的语句处理。
+    void fall_to(int object);
+
+    //语句代替其他行执行了若干步时调用：融合语句计后一行，PARALLEL FOR计各次迭代。
+    //这些步数与语句本身一样计入限制与resume_run_的步数。
+    void count_steps_(long steps);
+
+/*
+ * Method: getCompiledProgram
+ * Usage: std::shared_ptr<const CompiledProgram> image = program.getCompiledProgram();
+ * -----------------------------------------------------------------------------------
+ * Returns the current version of the program, compiling it first if
+ * the program has been edited since it was last compiled.
+ */
+
+    std::shared_ptr<const CompiledProgram> getCompiledProgram();
+
+/*
+ * Method: setPrecomputeBudget
+ * Usage: program.setPrecomputeBudget(steps);
+ * ------------------------------------------
+ * Enables partial evaluation of programs that cannot reach an INPUT
+ * statement or a PARALLEL FOR.  The first RUN of each version executes
+ * such a program on a fresh state, for at most the given number of
+ * statements.  A run that never reads a variable it has not assigned
+ * itself does the same from any state, so its output, the variables it
+ * assigned and any error it stopped with are remembered, and later
+ * RUNs of the version replay them instead of executing the program.
+ * If the budget runs out, the same RUN continues the program with the
+ * variables defined before it, and the version is not tried again; so
+ * is a version that reads a variable it has not assigned.  Any edit to
+ * the program discards the result.  A budget of zero, the default,
+ * disables the mode.
+ */
+
+    void setPrecomputeBudget(long steps);
+
+/*
+ * Method: setRunLimits
+ * Usage: program.setRunLimits(limits);
+ * ------------------------------------
+ * Sets the limits of the runs started from now on.  A run checks them
+ * whenever it jumps back to an earlier line and when it ends, so a run
+ * that exceeds one is stopped within one pass over the program, with
+ * the error STATEMENT LIMIT EXCEEDED, TIME LIMIT EXCEEDED, VARIABLE
+ * LIMIT EXCEEDED or OUTPUT LIMIT EXCEEDED.  Output beyond the limit is
+ * dropped as soon as it is written.  Each line executed counts once
+ * towards the limit on statements, whichever way the program is
+ * executed.  The statements executed by the body of a PARALLEL FOR
+ * count towards it too, with its NEXT once per iteration, and every
+ * iteration of the body checks the limits.  A program with
+ * limits is never precomputed.
+ */
+
+    void setRunLimits(const RunLimits &limits);
+
+/*
+ * Method: getMemoryStats
+ * Usage: MemoryStats stats = program.getMemoryStats(state);
+ * ---------------------------------------------------------
+ * Returns the memory used by the program, by the table of symbols and
+ * by the variables of state.  The compiled version counts in full
+ * even if other programs share it, and so does the ReadyImage, whose
+ * statements are kept apart from those of the compiled version.
+ */
+
+    MemoryStats getMemoryStats(const EvalState& state);
+
+/*
+ * Method: list_memory_
+ * Usage: program.list_memory_(state, out);
+ * ----------------------------------------
+ * Writes the figures of getMemoryStats to out, one per line with its
+ * name in capitals, followed by their total.  This is the MEM command.
+ */
+
+    void list_memory_(const EvalState& state, std::ostream& out);
+
+/*
+ * Method: setJournal
+ * Usage: program.setJournal(&journal);
+ * ------------------------------------
+ * Records every later edit of the program in journal before making it,
+ * so that an edit the journal cannot record raises an error and leaves
+ * the program as it was.  EditJournal::attach calls this method once
+ * it has restored the program; a null journal stops the recording.
+ */
+
+    void setJournal(EditJournal* journal);
+
+/*
+ * Method: setExpressionSharing
+ * Usage: program.setExpressionSharing(true);
+ * ------------------------------------------
+ * When enabled, the lines added from now on keep their expressions in
+ * an ExpressionPool owned by the program, so that an expression that
+ * appears on many lines, such as X + 1, is stored once and shared by
+ * all of them.  This is meant for large generated programs.  The
+ * compiled version is not affected, since compiling rewrites the
+ * expressions of its own copy of the lines and then flattens them.
+ * The mode is off by default.
+ */
+
+    void setExpressionSharing(bool enabled);
+
 private:
-    int max_line;
-    int pointer;
+    //各行共享的表达式，须比使用它们的ready_与run_存在得更久，故最先声明。
+    std::unique_ptr<ExpressionPool> pool_;
+    bool sharing_ = false;
+
     std::set<int> line_numbers_;
-    std::unordered_map<int, std::string> storage;
-    std::unordered_map<int, Statement*> ram;
+    //各行的文本，以记号形式存放。
+    LineStore storage;
+    //各行解析后的语句，每次修改时就地更新；运行中的run_可能与之共享。
+    std::shared_ptr<ReadyImage> ready_;
+    //自上次CLEAR以来是否运行过，及上次运行之后是否修改过。
+    bool ran_ = false;
+    bool edited_ = false;
+
+    //当前版本，程序修改后置空，下次运行前重新取得。
+    std::shared_ptr<const CompiledProgram> image_;
+
+    //记录各次修改的日志，可为空。
+    EditJournal* journal_ = nullptr;
+
+    //取得当前文本对应的版本：先查找共享的版本，否则编译。
+    void prepare_();
+
+    //取得可修改的ready_，其正被运行时先复制一份。
+    ReadyImage& edit_ready_();
+
+    //本次运行是否直接执行ready_。
+    bool use_ready_();
+
+    //程序被修改，丢弃当前版本与预计算结果。
+    void invalidate_();
+
+    //正在进行的运行：所用版本、下一行、正在执行的行、上一行与停止的行。
+    //有限制时另记已执行的语句数、截止时间与计数的输出。
+    //限制语句数时，检查限制时把executed并入shared；PARALLEL FOR的各循环体共用该计数。
+    //执行ready_时，image为空，另记所用的ready_、正在执行的槽与下一槽。
+    //counted为刚执行完的语句另计的步数，见count_steps_。
+    struct Run {
+        std::shared_ptr<const CompiledProgram> image;
+        std::shared_ptr<const ReadyImage> ready;
+        int slot = -1;
+        int next = -1;
+        int pointer = -1;
+        int current = -1;
+        int previous = -1;
+        int stop = -1;
+        bool running = false;
+        RunLimits limits;
+        long executed = 0;
+        long counted = 0;
+        std::shared_ptr<std::atomic<long>> shared;
+        std::chrono::steady_clock::time_point deadline;
+        std::shared_ptr<OutputLimit> output;
+    };
+
+    Run run_;
+    RunLimits limits_;
+
+    //向后跳转与运行结束时检查限制，超出则报错。
+    void check_limits_(EvalState& eval);
+
+    //当前版本的预计算结果：final中只有运行中赋值的变量。
+    //exhausted表示该版本不能预计算。
+    struct Precomputed {
+        bool valid = false;
+        bool exhausted = false;
+        EvalState final;
+        std::string output;
+        bool failed = false;
+        std::string message;
+    };
+
+    long precompute_budget_ = 0;
+    Precomputed precomputed_;
+
+    //在新状态上预计算当前版本；预算用尽时在eval上继续运行并返回true。
+    bool precompute_(EvalState& eval);
 };
 
 #endif
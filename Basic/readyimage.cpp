@@ -0,0 +1,153 @@
+/*
+ * File: readyimage.cpp
+ * --------------------
+ * Implements the readyimage.h interface.
+ */
+
+#include <algorithm>
+#include <utility>
+#include "readyimage.hpp"
+#include "statement.hpp"
+
+/*
+ * Implementation notes: set, remove
+ * ---------------------------------
+ * referrers_ lists the jumps by the line number they name, whether or
+ * not that line exists, so adding or removing a line only has to look
+ * at the jumps listed under its number.  A jump to a missing line has
+ * no target slot, and the run reports the error when it is taken.
+ */
+
+void ReadyImage::set(int lineNumber, int previous, std::shared_ptr<Statement> stmt) {
+    auto iter = index_.find(lineNumber);
+    if (iter != index_.end()) {
+        int slot = (*iter).second;
+        detach(slot);
+        code_[slot] = std::move(stmt);
+        attach(slot);
+        return;
+    }
+    int slot;
+    if (!free_.empty()) {
+        slot = free_.back();
+        free_.pop_back();
+    }
+    else {
+        slot = (int) lines_.size();
+        lines_.push_back(-1);
+        code_.emplace_back();
+        previous_.push_back(-1);
+        next_.push_back(-1);
+        target_.push_back(-1);
+    }
+    int before = find(previous);
+    int after = before == -1 ? first_ : next_[before];
+    lines_[slot] = lineNumber;
+    code_[slot] = std::move(stmt);
+    previous_[slot] = before;
+    next_[slot] = after;
+    if (before == -1) first_ = slot;
+    else next_[before] = slot;
+    if (after != -1) previous_[after] = slot;
+    index_[lineNumber] = slot;
+    auto jumps = referrers_.find(lineNumber);
+    if (jumps != referrers_.end()) {
+        for (int jump : (*jumps).second) {
+            target_[jump] = slot;
+        }
+    }
+    attach(slot);
+}
+
+void ReadyImage::remove(int lineNumber) {
+    auto iter = index_.find(lineNumber);
+    if (iter == index_.end()) return;
+    int slot = (*iter).second;
+    detach(slot);
+    index_.erase(iter);
+    auto jumps = referrers_.find(lineNumber);
+    if (jumps != referrers_.end()) {
+        for (int jump : (*jumps).second) {
+            target_[jump] = -1;
+        }
+    }
+    int before = previous_[slot];
+    int after = next_[slot];
+    if (before == -1) first_ = after;
+    else next_[before] = after;
+    if (after != -1) previous_[after] = before;
+    lines_[slot] = -1;
+    code_[slot].reset();
+    free_.push_back(slot);
+}
+
+void ReadyImage::attach(int slot) {
+    Statement *stmt = code_[slot].get();
+    StatementType type = stmt->getType();
+    if (type == PARALLEL_STMT || type == NEXT_STMT) ++parallel_;
+    target_[slot] = -1;
+    if (type == GOTO_STMT || type == IF_STMT) {
+        int target = ((Control *) stmt)->getTarget();
+        referrers_[target].push_back(slot);
+        target_[slot] = find(target);
+    }
+}
+
+void ReadyImage::detach(int slot) {
+    Statement *stmt = code_[slot].get();
+    StatementType type = stmt->getType();
+    if (type == PARALLEL_STMT || type == NEXT_STMT) --parallel_;
+    if (type == GOTO_STMT || type == IF_STMT) {
+        auto jumps = referrers_.find(((Control *) stmt)->getTarget());
+        std::vector<int> &slots = (*jumps).second;
+        slots.erase(std::find(slots.begin(), slots.end(), slot));
+        if (slots.empty()) referrers_.erase(jumps);
+    }
+}
+
+int ReadyImage::find(int lineNumber) const {
+    auto iter = index_.find(lineNumber);
+    return iter == index_.end() ? -1 : (*iter).second;
+}
+
+int ReadyImage::getFirst() const {
+    return first_;
+}
+
+int ReadyImage::getNext(int slot) const {
+    return next_[slot];
+}
+
+int ReadyImage::getLine(int slot) const {
+    return slot == -1 ? -1 : lines_[slot];
+}
+
+Statement *ReadyImage::getCode(int slot) const {
+    return code_[slot].get();
+}
+
+int ReadyImage::getTarget(int slot) const {
+    return target_[slot];
+}
+
+bool ReadyImage::hasParallel() const {
+    return parallel_ != 0;
+}
+
+void ReadyImage::measure(MemoryStats &stats) const {
+    stats.lines += vectorBytes(lines_) + vectorBytes(code_) + vectorBytes(previous_) + vectorBytes(next_)
+                   + vectorBytes(target_) + vectorBytes(free_);
+    stats.lines += hashBytes(index_.size(), index_.bucket_count(), sizeof(std::pair<const int, int>));
+    stats.lines += hashBytes(referrers_.size(), referrers_.bucket_count(),
+                             sizeof(std::pair<const int, std::vector<int>>));
+    for (auto iter = referrers_.begin(); iter != referrers_.end(); ++iter) {
+        stats.lines += vectorBytes((*iter).second);
+    }
+    for (const std::shared_ptr<Statement> &stmt : code_) {
+        if (!stmt) continue;
+        stats.statements += measureStatement(stmt.get());
+        for (Expression **root : stmt->getExpressions()) {
+            stats.expressions += measureExpression(*root);
+        }
+    }
+}
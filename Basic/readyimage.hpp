@@ -0,0 +1,128 @@
+/*
+ * File: readyimage.h
+ * ------------------
+ * This interface exports the ReadyImage class, a form of a program that
+ * is kept ready to run while its lines are edited.
+ */
+
+#ifndef _readyimage_h
+#define _readyimage_h
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "memory.hpp"
+
+class Statement;
+
+/*
+ * Class: ReadyImage
+ * -----------------
+ * A ReadyImage holds the parsed statement of every line of a program in
+ * a slot of its own, which keeps its index for as long as the line
+ * exists.  The slots are linked in the order of the line numbers, and
+ * the slot of each GOTO and IF records the slot of its target line, so
+ * a run can follow the program without looking up line numbers.  An
+ * edit touches only the slot of the edited line and the slots of the
+ * jumps to that line, whatever the size of the program.  The statements
+ * are run as parsed, without the optimizations of a CompiledProgram.
+ *
+ * Copies share their statements, which are never changed once added.
+ */
+
+class ReadyImage {
+
+public:
+
+/*
+ * Method: set
+ * Usage: image.set(lineNumber, previous, stmt);
+ * ---------------------------------------------
+ * Makes stmt the statement of the line with the specified number.  A
+ * new line is linked after the line previous, which is -1 if the new
+ * line comes first.
+ */
+
+    void set(int lineNumber, int previous, std::shared_ptr<Statement> stmt);
+
+/*
+ * Method: remove
+ * Usage: image.remove(lineNumber);
+ * --------------------------------
+ * Removes the line with the specified number, if there is one.
+ */
+
+    void remove(int lineNumber);
+
+/*
+ * Method: find
+ * Usage: int slot = image.find(lineNumber);
+ * -----------------------------------------
+ * Returns the slot of the line with the specified number, or -1 if
+ * there is no such line.
+ */
+
+    int find(int lineNumber) const;
+
+/*
+ * Methods: getFirst, getNext, getLine, getCode, getTarget
+ * Usage: for (int slot = image.getFirst(); slot != -1; slot = image.getNext(slot)) . . .
+ * --------------------------------------------------------------------------------------
+ * Return the slot of the first line, the slot of the line after slot,
+ * the line number and the statement of slot and the slot of the target
+ * of the GOTO or IF in slot.  A missing slot is -1, and getLine(-1) is
+ * -1 as well.
+ */
+
+    int getFirst() const;
+    int getNext(int slot) const;
+    int getLine(int slot) const;
+    Statement *getCode(int slot) const;
+    int getTarget(int slot) const;
+
+/*
+ * Method: hasParallel
+ * Usage: if (image.hasParallel()) . . .
+ * -------------------------------------
+ * Returns true if any line is a PARALLEL FOR or a NEXT.  Such lines
+ * must be linked and checked against the whole program, so a program
+ * that has them is only run compiled.
+ */
+
+    bool hasParallel() const;
+
+/*
+ * Method: measure
+ * Usage: image.measure(stats);
+ * ----------------------------
+ * Adds the memory used by the image to stats: its slots and indices to
+ * lines, and its statements and their expressions to statements and
+ * expressions.
+ */
+
+    void measure(MemoryStats &stats) const;
+
+private:
+    //各槽：行号、语句、前后相邻行的槽与跳转目标的槽，空槽的行号为-1。
+    std::vector<int> lines_;
+    std::vector<std::shared_ptr<Statement>> code_;
+    std::vector<int> previous_;
+    std::vector<int> next_;
+    std::vector<int> target_;
+    //可重用的空槽。
+    std::vector<int> free_;
+    int first_ = -1;
+    //行号->槽。
+    std::unordered_map<int, int> index_;
+    //目标行号->跳转到该行的GOTO与IF所在的槽，不论该行是否存在。
+    std::unordered_map<int, std::vector<int>> referrers_;
+    //PARALLEL与NEXT语句的个数。
+    int parallel_ = 0;
+
+    //登记或注销slot中语句的跳转与PARALLEL计数。
+    void attach(int slot);
+    void detach(int slot);
+
+};
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * File: scheduler.cpp
+ * -------------------
+ * Implements the scheduler.h interface.
+ */
+
+#include <ctime>
+#include "scheduler.hpp"
+#include "Utils/error.hpp"
+
+namespace {
+
+long long threadTime() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+}
+
+Scheduler::Scheduler(long quantum) : quantum(quantum > 0 ? quantum : 1) {
+}
+
+int Scheduler::add(Program &program, EvalState &state) {
+    state.setInputSuspends(true);
+    std::lock_guard<std::mutex> guard(lock);
+    int id = next_id++;
+    Entry &entry = entries[id];
+    entry.program = &program;
+    entry.state = &state;
+    ready.push_back(id);
+    return id;
+}
+
+void Scheduler::wake(int id) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto iter = entries.find(id);
+    if (iter == entries.end() || !(*iter).second.parked) return;
+    (*iter).second.parked = false;
+    ready.push_back(id);
+}
+
+void Scheduler::cancel(int id) {
+    std::lock_guard<std::mutex> guard(lock);
+    entries.erase(id);
+}
+
+/*
+ * Implementation notes: runSlice
+ * ------------------------------
+ * A cancelled run may still have its number in the queue, so numbers
+ * without an entry are skipped.  The run is taken off the queue while
+ * the lock is held and executed after it is released, so no other
+ * thread can pick it up meanwhile, and it is looked up again afterwards
+ * in case it was cancelled.  The time is measured on the clock of the
+ * calling thread, which only advances while the slice executes.
+ */
+
+bool Scheduler::runSlice(Slice &slice) {
+    Program *program;
+    EvalState *state;
+    int id;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        while (!ready.empty() && entries.find(ready.front()) == entries.end()) {
+            ready.pop_front();
+        }
+        if (ready.empty()) return false;
+        id = ready.front();
+        ready.pop_front();
+        program = entries[id].program;
+        state = entries[id].state;
+    }
+    slice = Slice();
+    slice.id = id;
+    long long start = threadTime();
+    try {
+        slice.status = program->resume_run_(*state, quantum);
+    }
+    catch (ErrorException &ex) {
+        slice.status = RUN_FINISHED;
+        slice.failed = true;
+        slice.message = ex.getMessage();
+    }
+    long long cpu = threadTime() - start;
+    std::lock_guard<std::mutex> guard(lock);
+    auto iter = entries.find(id);
+    if (iter == entries.end()) {
+        slice.status = RUN_FINISHED;
+        return true;
+    }
+    Entry &entry = (*iter).second;
+    entry.cpu += cpu;
+    entry.slices++;
+    slice.cpu = entry.cpu;
+    slice.slices = entry.slices;
+    if (slice.status == RUN_PREEMPTED) {
+        ready.push_back(id);
+    }
+    else if (slice.status == RUN_WAITING) {
+        entry.parked = true;
+    }
+    else {
+        entries.erase(iter);
+    }
+    return true;
+}
+
+bool Scheduler::isReady() const {
+    std::lock_guard<std::mutex> guard(lock);
+    for (int id : ready) {
+        if (entries.count(id) != 0) return true;
+    }
+    return false;
+}
+
+bool Scheduler::isParked(int id) const {
+    std::lock_guard<std::mutex> guard(lock);
+    auto iter = entries.find(id);
+    return iter != entries.end() && (*iter).second.parked;
+}
+
+Slice Scheduler::getUsage(int id) const {
+    Slice usage;
+    std::lock_guard<std::mutex> guard(lock);
+    auto iter = entries.find(id);
+    if (iter == entries.end()) return usage;
+    usage.id = id;
+    usage.status = (*iter).second.parked ? RUN_WAITING : RUN_PREEMPTED;
+    usage.cpu = (*iter).second.cpu;
+    usage.slices = (*iter).second.slices;
+    return usage;
+}
@@ -0,0 +1,150 @@
+/*
+ * File: scheduler.h
+ * -----------------
+ * This interface exports a Scheduler, which shares a few threads among
+ * many runs of BASIC programs by executing them in turn, a slice of
+ * statements at a time.
+ */
+
+#ifndef _scheduler_h
+#define _scheduler_h
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "program.hpp"
+#include "evalstate.hpp"
+
+/*
+ * Type: Slice
+ * -----------
+ * What happened to a run during one call to Scheduler::runSlice.  If
+ * status is RUN_FINISHED the run has left the scheduler, because it
+ * ended or was cancelled while the slice executed, and failed and
+ * message tell whether it ended with an error.  cpu and slices are
+ * the totals of the run so far.
+ */
+
+struct Slice {
+    int id = -1;
+    RunStatus status = RUN_FINISHED;
+    bool failed = false;
+    std::string message;
+    long long cpu = 0;
+    long slices = 0;
+};
+
+/*
+ * Class: Scheduler
+ * ----------------
+ * Keeps a queue of runs that are ready to execute and the runs that
+ * are parked because an INPUT found no line.  Each call to runSlice
+ * lets the run at the front of the queue execute at most quantum
+ * statements and then moves it to the back, so an endless program
+ * only delays the others by one slice per turn.  The scheduler never
+ * blocks: feeding a parked run is left to the caller, which passes a
+ * line to supplyInput of its state and calls wake.  The scheduler does
+ * not own the programs or the states, which must outlive their runs.
+ *
+ * All the methods may be called from any thread.  Several threads may
+ * call runSlice at once, and each of them then executes a different
+ * run, so a slice that takes long only holds up its own thread.
+ */
+
+class Scheduler {
+
+public:
+
+/*
+ * Constructor: Scheduler
+ * Usage: Scheduler scheduler(quantum);
+ * ------------------------------------
+ * Creates an empty scheduler whose slices are at most quantum
+ * statements long.
+ */
+
+    explicit Scheduler(long quantum);
+
+/*
+ * Method: add
+ * Usage: int id = scheduler.add(program, state);
+ * ----------------------------------------------
+ * Queues the run that program.begin_run_(state) has started and
+ * returns the number that identifies it.  The state is made to suspend
+ * on INPUT instead of blocking.
+ */
+
+    int add(Program &program, EvalState &state);
+
+/*
+ * Method: wake
+ * Usage: scheduler.wake(id);
+ * --------------------------
+ * Moves a parked run back to the end of the queue.  Nothing happens if
+ * the run is not parked.
+ */
+
+    void wake(int id);
+
+/*
+ * Method: cancel
+ * Usage: scheduler.cancel(id);
+ * ----------------------------
+ * Removes a run from the scheduler without finishing it.
+ */
+
+    void cancel(int id);
+
+/*
+ * Method: runSlice
+ * Usage: Slice slice;
+ *        if (scheduler.runSlice(slice)) . . .
+ * -------------------------------------------
+ * Executes one slice of the run at the front of the queue and describes
+ * the outcome in slice.  A run that used up its quantum goes to the
+ * back of the queue.  Returns false, doing nothing, if no run is
+ * ready.
+ */
+
+    bool runSlice(Slice &slice);
+
+/*
+ * Methods: isReady, isParked, getUsage
+ * Usage: if (scheduler.isReady()) . . .
+ *        if (scheduler.isParked(id)) . . .
+ *        Slice usage = scheduler.getUsage(id);
+ * ---------------------------------------------
+ * isReady tells whether runSlice has anything to do, isParked whether
+ * the given run is waiting for input, and getUsage returns the
+ * processor time in nanoseconds and the number of slices the run has
+ * consumed so far.
+ */
+
+    bool isReady() const;
+
+    bool isParked(int id) const;
+
+    Slice getUsage(int id) const;
+
+private:
+
+    //调度中的一次运行及其累计的CPU时间与时间片数。
+    struct Entry {
+        Program *program;
+        EvalState *state;
+        bool parked = false;
+        long long cpu = 0;
+        long slices = 0;
+    };
+
+    long quantum;
+    //保护以下各项；执行时间片时不持有。
+    mutable std::mutex lock;
+    int next_id = 0;
+    std::unordered_map<int, Entry> entries;
+    std::deque<int> ready;
+
+};
+
+#endif
@@ -0,0 +1,595 @@
+/*
+ * File: server.cpp
+ * ----------------
+ * Implements the server.h interface.
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <sstream>
+#include <streambuf>
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.hpp"
+#include "interpreter.hpp"
+#include "scheduler.hpp"
+#include "Utils/error.hpp"
+#include "Utils/threadPool.hpp"
+
+/*
+ * Implementation notes: sessions
+ * ------------------------------
+ * Each connection owns a Session.  The epoll thread appends the bytes
+ * it reads to the input of the session and sends the bytes the session
+ * has written; everything else, including the processing of lines,
+ * happens on a worker.  A session is handed to a worker whenever it
+ * has a complete line and no worker owns it yet, and the worker keeps
+ * it until no complete line is left.  The state of a session suspends
+ * on INPUT, so no worker ever waits for the user: an INPUT that finds
+ * no line parks the session, and the next line that arrives hands it
+ * to a worker again, which continues where the session stopped.  All
+ * the fields shared by the two sides are guarded by the lock of the
+ * session.
+ *
+ * With a quantum, a worker that meets RUN starts the run, queues it on
+ * a Scheduler and lets the session go.  The runs of all sessions are
+ * then executed by the workers a slice at a time, one task per slice,
+ * and a run that used up its quantum queues another task behind the
+ * ones already waiting, so neither the lines of other sessions nor the
+ * other runs wait for more than a slice.  INPUT of such a run parks
+ * it instead of blocking, and whichever side sees the next line first,
+ * the epoll thread or the worker that parked it, feeds it and queues
+ * its next slice.  When the run ends, its processor time is logged and
+ * the session goes back to a worker for the lines after RUN.
+ */
+
+class Server;
+struct Session;
+
+namespace {
+
+void logUsage(const Slice &slice, int fd, const char *outcome) {
+    std::ostringstream usage;
+    usage << "run " << slice.id << " of session " << fd << " " << outcome << ": "
+          << slice.cpu / 1000000.0 << " ms cpu in " << slice.slices << " slices\n";
+    std::cerr << usage.str() << std::flush;
+}
+
+}
+
+class SessionInput : public std::streambuf {
+public:
+    explicit SessionInput(Session &session);
+protected:
+    virtual int_type underflow();
+private:
+    Session &session;
+    std::string line;
+};
+
+class SessionOutput : public std::streambuf {
+public:
+    explicit SessionOutput(Session &session);
+protected:
+    virtual int_type overflow(int_type ch);
+    virtual int sync();
+private:
+    Session &session;
+    char buffer[1024];
+};
+
+struct Session {
+    Session(int fd, Server &server);
+
+    int fd;
+    Server &server;
+    Program program;
+    EvalState state;
+
+    std::mutex lock;
+    std::condition_variable arrived;
+    std::string input;
+    std::string output;
+    bool scheduled = false;
+    bool hangup = false;
+    bool finished = false;
+    bool writable = true;
+    bool parked = false;
+    std::string resume;
+    std::atomic<int> run{-1};
+
+    SessionInput inbuf;
+    SessionOutput outbuf;
+    std::istream in;
+    std::ostream out;
+
+    bool hasLine() const {
+        return input.find('\n') != std::string::npos;
+    }
+};
+
+class Server {
+public:
+    Server(int listener, int workers, long precompute, long quantum, const RunLimits &limits);
+    ~Server();
+    void run();
+    void notify(const std::shared_ptr<Session> &session);
+    void notify(Session &session);
+private:
+    int listener;
+    int epoll;
+    int wakeup;
+    long precompute;
+    long quantum;
+    RunLimits limits;
+    ThreadPool pool;
+    Scheduler scheduler;
+    std::unordered_map<int, std::shared_ptr<Session>> sessions;
+    std::mutex runningLock;
+    std::unordered_map<int, std::shared_ptr<Session>> running;
+    std::mutex pendingLock;
+    std::vector<int> pending;
+
+    void accept();
+    void receive(const std::shared_ptr<Session> &session);
+    void flush(const std::shared_ptr<Session> &session);
+    void close(const std::shared_ptr<Session> &session);
+    void drain(const std::shared_ptr<Session> &session);
+    bool park(const std::shared_ptr<Session> &session, const std::string &line);
+    void step();
+    void feed(const std::shared_ptr<Session> &session);
+};
+
+SessionInput::SessionInput(Session &session) : session(session) {
+}
+
+/*
+ * Implementation notes: underflow
+ * -------------------------------
+ * The buffer hands out one line at a time, so that after processLine
+ * or INPUT has read a line nothing of the next one is left in it, and
+ * Session::hasLine tells exactly whether a worker has work to do.  A
+ * carriage return before the newline is dropped.
+ */
+
+SessionInput::int_type SessionInput::underflow() {
+    std::unique_lock<std::mutex> guard(session.lock);
+    session.arrived.wait(guard, [this] { return session.hasLine() || session.hangup; });
+    size_t end = session.input.find('\n');
+    if (end == std::string::npos) {
+        if (session.input.empty()) return traits_type::eof();
+        end = session.input.size() - 1;
+    }
+    line = session.input.substr(0, end + 1);
+    session.input.erase(0, end + 1);
+    if (line.size() >= 2 && line[line.size() - 2] == '\r' && line.back() == '\n') {
+        line.erase(line.size() - 2, 1);
+    }
+    setg(&line[0], &line[0], &line[0] + line.size());
+    return traits_type::to_int_type(line[0]);
+}
+
+SessionOutput::SessionOutput(Session &session) : session(session) {
+    setp(buffer, buffer + sizeof(buffer));
+}
+
+SessionOutput::int_type SessionOutput::overflow(int_type ch) {
+    sync();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int SessionOutput::sync() {
+    if (pptr() == pbase()) return 0;
+    {
+        std::lock_guard<std::mutex> guard(session.lock);
+        if (session.writable) session.output.append(pbase(), pptr());
+    }
+    setp(buffer, buffer + sizeof(buffer));
+    session.server.notify(session);
+    return 0;
+}
+
+Session::Session(int fd, Server &server)
+        : fd(fd), server(server), inbuf(*this), outbuf(*this), in(&inbuf), out(&outbuf) {
+    in.tie(&out);
+    state.setInput(in);
+    state.setOutput(out);
+    state.setInputSuspends(true);
+}
+
+Server::Server(int listener, int workers, long precompute, long quantum, const RunLimits &limits)
+        : listener(listener), precompute(precompute), quantum(quantum), limits(limits), pool(workers),
+          scheduler(quantum) {
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listener;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+    event.data.fd = wakeup;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, wakeup, &event);
+}
+
+Server::~Server() {
+    ::close(wakeup);
+    ::close(epoll);
+}
+
+void Server::run() {
+    std::vector<epoll_event> events(256);
+    while (true) {
+        int count = epoll_wait(epoll, events.data(), (int) events.size(), -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait: " << strerror(errno) << std::endl;
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listener) {
+                accept();
+                continue;
+            }
+            if (fd == wakeup) {
+                uint64_t value;
+                while (read(wakeup, &value, sizeof(value)) > 0) {}
+                std::vector<int> ready;
+                {
+                    std::lock_guard<std::mutex> guard(pendingLock);
+                    ready.swap(pending);
+                }
+                for (int session : ready) {
+                    auto iter = sessions.find(session);
+                    if (iter != sessions.end()) flush(iter->second);
+                }
+                continue;
+            }
+            auto iter = sessions.find(fd);
+            if (iter == sessions.end()) continue;
+            std::shared_ptr<Session> session = iter->second;
+            if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                // The peer is gone, so nothing written to it would be read.
+                std::lock_guard<std::mutex> guard(session->lock);
+                session->writable = false;
+                session->output.clear();
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) receive(session);
+            if (events[i].events & EPOLLOUT) flush(session);
+        }
+    }
+}
+
+/*
+ * Implementation notes: notify
+ * ----------------------------
+ * Workers never touch the sockets.  They record which session has
+ * something for the epoll thread to do, which is either output to send
+ * or a finished session to close, and wake the thread through an
+ * eventfd.
+ */
+
+void Server::notify(const std::shared_ptr<Session> &session) {
+    notify(*session);
+}
+
+void Server::notify(Session &session) {
+    {
+        std::lock_guard<std::mutex> guard(pendingLock);
+        pending.push_back(session.fd);
+    }
+    uint64_t one = 1;
+    (void) write(wakeup, &one, sizeof(one));
+}
+
+void Server::accept() {
+    while (true) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        std::shared_ptr<Session> session = std::make_shared<Session>(fd, *this);
+        session->program.setPrecomputeBudget(precompute);
+        session->program.setRunLimits(limits);
+        sessions[fd] = session;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void Server::receive(const std::shared_ptr<Session> &session) {
+    char buffer[4096];
+    bool hangup = false;
+    std::string received;
+    while (true) {
+        ssize_t length = read(session->fd, buffer, sizeof(buffer));
+        if (length > 0) {
+            received.append(buffer, length);
+            continue;
+        }
+        if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (length < 0 && errno == EINTR) continue;
+        hangup = true;
+        break;
+    }
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> guard(session->lock);
+        if (session->finished) return;
+        session->input += received;
+        if (hangup) session->hangup = true;
+        if (!session->scheduled && (session->hasLine() || session->hangup)) {
+            session->scheduled = true;
+            schedule = true;
+        }
+    }
+    session->arrived.notify_all();
+    if (hangup) {
+        epoll_ctl(epoll, EPOLL_CTL_DEL, session->fd, nullptr);
+    }
+    if (session->run != -1) feed(session);
+    if (schedule) {
+        pool.submit([this, session] { drain(session); });
+    }
+}
+
+void Server::flush(const std::shared_ptr<Session> &session) {
+    std::unique_lock<std::mutex> guard(session->lock);
+    while (!session->output.empty() && session->writable) {
+        ssize_t length = send(session->fd, session->output.data(), session->output.size(), MSG_NOSIGNAL);
+        if (length > 0) {
+            session->output.erase(0, length);
+            continue;
+        }
+        if (length < 0 && errno == EINTR) continue;
+        if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        session->writable = false;
+        session->output.clear();
+    }
+    if (!session->hangup) {
+        epoll_event event{};
+        event.events = EPOLLIN | (session->output.empty() ? 0u : (uint32_t) EPOLLOUT);
+        event.data.fd = session->fd;
+        epoll_ctl(epoll, EPOLL_CTL_MOD, session->fd, &event);
+    }
+    else if (!session->output.empty()) {
+        epoll_event event{};
+        event.events = EPOLLOUT;
+        event.data.fd = session->fd;
+        if (epoll_ctl(epoll, EPOLL_CTL_MOD, session->fd, &event) < 0) {
+            epoll_ctl(epoll, EPOLL_CTL_ADD, session->fd, &event);
+        }
+    }
+    bool done = session->finished && session->output.empty();
+    guard.unlock();
+    if (done) close(session);
+}
+
+/*
+ * Implementation notes: drain
+ * ---------------------------
+ * This is the loop of main for one session, except that it returns as
+ * soon as no complete line is waiting instead of blocking.  The check
+ * and the release of the session happen under its lock, so a line that
+ * arrives meanwhile either is seen here or schedules the session again.
+ *
+ * A parked session takes the next line as the answer to its INPUT and
+ * continues either the run, with resume_run_, or the INPUT command it
+ * was executing, by processing that line again; the prompt is not
+ * printed twice.  Once the connection has hung up with nothing left,
+ * INPUT reads the stream instead and fails with END OF INPUT.
+ */
+
+void Server::drain(const std::shared_ptr<Session> &session) {
+    while (true) {
+        bool parked;
+        {
+            std::lock_guard<std::mutex> guard(session->lock);
+            parked = session->parked;
+            if (!session->hasLine()) {
+                if (!session->hangup) {
+                    session->scheduled = false;
+                    return;
+                }
+                if (session->input.empty() && !parked) break;
+                if (!session->input.empty()) session->input += '\n';
+            }
+            session->parked = false;
+        }
+        std::string line;
+        if (parked) {
+            if (getline(session->in, line)) session->state.supplyInput(line);
+            else session->state.setInputSuspends(false);
+            try {
+                if (session->resume.empty()) session->program.resume_run_(session->state, -1);
+                else processLine(session->resume, session->program, session->state);
+            } catch (ErrorException &ex) {
+                session->out << ex.getMessage() << std::endl;
+            }
+            session->out.flush();
+            if (park(session, session->resume)) return;
+            continue;
+        }
+        getline(session->in, line);
+        if (line.empty()) continue;
+        if (quantum > 0 && isRunCommand(line)) {
+            try {
+                session->program.begin_run_(session->state);
+            } catch (ErrorException &ex) {
+                session->out << ex.getMessage() << std::endl;
+                continue;
+            }
+            session->out.flush();
+            {
+                std::lock_guard<std::mutex> guard(runningLock);
+                session->run = scheduler.add(session->program, session->state);
+                running[session->run] = session;
+            }
+            pool.defer([this] { step(); });
+            return;
+        }
+        try {
+            processLine(line, session->program, session->state);
+        } catch (ErrorException &ex) {
+            session->out << ex.getMessage() << std::endl;
+        }
+        session->out.flush();
+        if (park(session, line)) return;
+        if (session->state.isQuitRequested()) break;
+    }
+    session->out.flush();
+    {
+        std::lock_guard<std::mutex> guard(session->lock);
+        session->finished = true;
+    }
+    notify(session);
+}
+
+/*
+ * Implementation notes: park
+ * --------------------------
+ * Called after each line.  If an INPUT is waiting, the session
+ * remembers what to continue, which is the run if one is in progress
+ * and otherwise the INPUT command in line.  The worker releases the
+ * session unless the answer has already arrived, and returns true if
+ * it did.
+ */
+
+bool Server::park(const std::shared_ptr<Session> &session, const std::string &line) {
+    if (!session->state.isWaitingForInput()) {
+        session->resume.clear();
+        return false;
+    }
+    session->resume = session->program.is_running_() ? "" : line;
+    std::lock_guard<std::mutex> guard(session->lock);
+    session->parked = true;
+    if (session->hasLine() || session->hangup) return false;
+    session->scheduled = false;
+    return true;
+}
+
+/*
+ * Implementation notes: step
+ * --------------------------
+ * Each task executes one slice of whichever run is at the front of the
+ * scheduler, and one task is queued for each run that becomes ready,
+ * so a task may find its run cancelled or already taken and simply
+ * returns.  A run whose connection can no longer be written to is
+ * dropped, since nobody would see its output.  The usage of a run that
+ * finishes or is dropped goes to the standard error stream as a single
+ * line.
+ */
+
+void Server::step() {
+    Slice slice;
+    if (!scheduler.runSlice(slice)) return;
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> guard(runningLock);
+        auto iter = running.find(slice.id);
+        if (iter == running.end()) return;
+        session = iter->second;
+        if (slice.status == RUN_FINISHED) running.erase(iter);
+    }
+    if (slice.status == RUN_FINISHED) {
+        session->run = -1;
+        logUsage(slice, session->fd, "finished");
+        if (slice.failed) session->out << slice.message << std::endl;
+        session->out.flush();
+        pool.submit([this, session] { drain(session); });
+        return;
+    }
+    session->out.flush();
+    bool writable;
+    {
+        std::lock_guard<std::mutex> guard(session->lock);
+        writable = session->writable;
+        if (!writable) session->finished = true;
+    }
+    if (!writable) {
+        scheduler.cancel(slice.id);
+        logUsage(slice, session->fd, "cancelled");
+        {
+            std::lock_guard<std::mutex> guard(runningLock);
+            running.erase(slice.id);
+        }
+        session->run = -1;
+        notify(session);
+        return;
+    }
+    if (slice.status == RUN_WAITING) feed(session);
+    else pool.defer([this] { step(); });
+}
+
+/*
+ * Implementation notes: feed
+ * --------------------------
+ * A parked run gets the next complete line, cut off as underflow cuts
+ * it.  Once the connection has hung up, INPUT goes back to reading the
+ * stream of the session, which returns what is left or the end of the
+ * input without waiting.  Both the epoll thread and a worker may feed
+ * the same run, so the whole of it happens under the lock of the
+ * session, and only the first of them finds the run parked.
+ */
+
+void Server::feed(const std::shared_ptr<Session> &session) {
+    {
+        std::lock_guard<std::mutex> guard(session->lock);
+        int run = session->run;
+        if (run == -1 || !scheduler.isParked(run)) return;
+        size_t end = session->input.find('\n');
+        if (end == std::string::npos && !session->hangup) return;
+        if (end == std::string::npos) {
+            session->state.setInputSuspends(false);
+        }
+        else {
+            std::string line = session->input.substr(0, end);
+            session->input.erase(0, end + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            session->state.supplyInput(line);
+        }
+        scheduler.wake(run);
+    }
+    pool.defer([this] { step(); });
+}
+
+void Server::close(const std::shared_ptr<Session> &session) {
+    epoll_ctl(epoll, EPOLL_CTL_DEL, session->fd, nullptr);
+    ::close(session->fd);
+    sessions.erase(session->fd);
+}
+
+
+int runServer(const std::string &path, int workers, long precompute, long quantum, const RunLimits &limits) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return 1;
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str());
+    if (listener < 0 || bind(listener, (sockaddr *) &address, sizeof(address)) < 0
+        || listen(listener, SOMAXCONN) < 0) {
+        std::cerr << "Cannot listen on " << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    Server server(listener, workers, precompute, quantum, limits);
+    server.run();
+    ::close(listener);
+    return 1;
+}
@@ -0,0 +1,43 @@
+/*
+ * File: server.h
+ * --------------
+ * This interface exports the server mode of the interpreter, in which
+ * one process serves many interactive users connected through a Unix
+ * domain socket.
+ */
+
+#ifndef _server_h
+#define _server_h
+
+#include <string>
+#include "program.hpp"
+
+/*
+ * Function: runServer
+ * Usage: return runServer(path, workers, precompute, quantum, limits);
+ * --------------------------------------------------------------------
+ * Listens on a Unix domain socket at the given path and serves every
+ * connection as if it were a separate console: each one has its own
+ * Program and EvalState, the lines it sends are processed in order by
+ * processLine, INPUT reads the following lines of the same connection
+ * and all output goes back to it.  QUIT closes the connection.
+ *
+ * A single thread waits on the sockets with epoll, and the lines are
+ * processed on a pool of worker threads, one session at a time per
+ * worker; workers gives the size of the pool, or one per core if it is
+ * not positive.  precompute and limits are passed to
+ * Program::setPrecomputeBudget and Program::setRunLimits for every
+ * session.
+ *
+ * If quantum is positive, RUN does not occupy a worker for good: the
+ * runs of all sessions take turns on the workers through a Scheduler,
+ * quantum statements at a time, so a program that never ends only
+ * slows the others down.  Such runs are not precomputed, and the
+ * processor time of each one is written to the standard error stream
+ * when it ends or is dropped.  The function only returns if the socket cannot be set
+ * up, in which case it returns a nonzero status.
+ */
+
+int runServer(const std::string &path, int workers, long precompute, long quantum, const RunLimits &limits);
+
+#endif
@@ -11,6 +11,14 @@
 #include "Utils/strlib.hpp"
 #include "Utils/tokenScanner.hpp"
 #include "parser.hpp"
+#include "optimizer.hpp"
+#include "Utils/threadPool.hpp"
+#include "symbols.hpp"
+#include "varstore.hpp"
+#include <climits>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 
 class Program;
 class Statement;
@@ -22,8 +30,13 @@ int stringToInt(std::string str);
 Statement::Statement() = default;
 
 Statement::~Statement() = default;
-void Statement::kill(){
-    return;
+std::vector<Expression **> Statement::getExpressions() {
+    return {};
+}
+void Statement::validate() {
+    for (Expression **root : getExpressions()) {
+        checkAssignments(*root);
+    }
 }
 
 Command::Command(TokenScanner& token) {
@@ -37,6 +50,15 @@ Command::Command(TokenScanner& token) {
     else if (order == "CLEAR") {
         type = CLEAR;
     }
+    else if (order == "MEM") {
+        type = MEM;
+    }
+    else if (order == "SAVEVARS") {
+        type = SAVEVARS;
+    }
+    else if (order == "LOADVARS") {
+        type = LOADVARS;
+    }
     else {
         error("SYNAXERROR");
     }
@@ -48,16 +70,37 @@ void Command::execute(EvalState& state ,Program& program) {
         break;
     }
     case LIST: {
-        program.list_program_();
+        program.list_program_(state.getOutput());
         break;
     }
     case CLEAR:{
         program.clear(state);
         break;
      }
+    case MEM: {
+        program.list_memory_(state, state.getOutput());
+        break;
+    }
+    case SAVEVARS:
+    case LOADVARS: {
+        VariableStore *store = state.getStore();
+        if (store == nullptr) {
+            error("NO VARIABLE STORE");
+        }
+        if (type == SAVEVARS) {
+            store->save(state);
+        }
+        else {
+            store->load(state);
+        }
+        break;
+    }
     }
     return;
 }
+StatementType Command::getType() {
+    return COMMAND_STMT;
+}
 
 Control::Control() {
     object_pointer_ = 0;
@@ -67,8 +110,8 @@ Control::~Control() = default;
 void Control::Set(int a) {
     object_pointer_ = a;
 }
-void Control::kill(){
-    return;
+int Control::getTarget() {
+    return object_pointer_;
 }
 void Control::jump(Program& program) {
     if (!program.set_pointer(object_pointer_)) {
@@ -84,10 +127,16 @@ GOTO::GOTO(TokenScanner& token) {
     int a = stringToInteger(next);
     Set(a);
 }
+GOTO::GOTO(int target) {
+    Set(target);
+}
 void GOTO::execute(EvalState& state, Program& program) {
     jump(program);
     return;
 }
+StatementType GOTO::getType() {
+    return GOTO_STMT;
+}
 
 
 IF::IF(TokenScanner& token) {
@@ -95,6 +144,9 @@ IF::IF(TokenScanner& token) {
     int object = 0;
     next=token.nextToken();
     while (1) {
+        if (!token.hasMoreTokens()) {
+            error("SYNTAX ERROR");
+        }
         next = token.nextToken();
         if (next == "THEN") {
             break;
@@ -109,7 +161,7 @@ IF::IF(TokenScanner& token) {
     TokenScanner new_token(expression);
     new_token.ignoreWhitespace();
     new_token.scanNumbers();
-    lhs = readE(new_token,1);
+    std::unique_ptr<Expression> left(readE(new_token,1));
     next=new_token.nextToken();
     if(next=="<"){
         compare='<';
@@ -117,18 +169,24 @@ IF::IF(TokenScanner& token) {
     else if(next=="="){
         compare='=';
     }
-    else{
+    else if(next==">"){
         compare='>';
     }
+    else{
+        compare=0;
+    }
     rhs=parseExp(new_token);
+    lhs = left.release();
+    shareSubexpressions({&lhs, &rhs});
 }
-IF::~IF() {
-    delete lhs;
-    delete rhs;
-    lhs = nullptr;
-    rhs=nullptr;
+IF::IF(Expression* lhs, char compare, Expression* rhs, int target) {
+    this->lhs = lhs;
+    this->rhs = rhs;
+    this->compare = compare;
+    Set(target);
+    shareSubexpressions({&this->lhs, &this->rhs});
 }
-void IF::kill(){
+IF::~IF() {
     delete lhs;
     delete rhs;
     lhs = nullptr;
@@ -136,6 +194,7 @@ void IF::kill(){
 }
 void IF::execute(EvalState& state, Program& program) {
     bool flag=0;
+    state.resetTemporaries();
     int a = (*lhs).eval(state);
     int b=(*rhs).eval(state);
     if(compare=='>'&& a>b){
@@ -152,25 +211,311 @@ void IF::execute(EvalState& state, Program& program) {
     }
     return;
 }
+StatementType IF::getType() {
+    return IF_STMT;
+}
+std::vector<Expression **> IF::getExpressions() {
+    return {&lhs, &rhs};
+}
+void IF::validate() {
+    Statement::validate();
+    if (compare == 0) {
+        error("SYNTAX ERROR");
+    }
+}
+Expression* IF::getLHS() {
+    return lhs;
+}
+Expression* IF::getRHS() {
+    return rhs;
+}
+char IF::getCompare() {
+    return compare;
+}
 
 END::END(TokenScanner& token) {
     Set(-1);
 }
+END::END() {
+    Set(-1);
+}
 void END::execute(EvalState& state, Program& program) {
     jump(program);
     return;
 }
+StatementType END::getType() {
+    return END_STMT;
+}
+
+CountedLoop::CountedLoop(int variable, int step, int compare_line,
+                         Expression** bound, bool bound_first, char compare, int target) {
+    this->variable = variable;
+    this->step = step;
+    this->compare_line = compare_line;
+    this->bound = bound;
+    this->bound_first = bound_first;
+    this->compare = compare;
+    Set(target);
+}
+//与依次执行LET与IF等价，包括报错的时机。
+void CountedLoop::execute(EvalState& state, Program& program) {
+    if (!state.isDefined(variable)) error("VARIABLE NOT DEFINED");
+    int value = (int) ((unsigned) state.getValue(variable) + (unsigned) step);
+    state.setValue(variable, value);
+    program.fall_to(compare_line);
+    program.count_steps_(1);
+    state.resetTemporaries();
+    int a = value, b = (*bound)->eval(state);
+    if (bound_first) {
+        a = b;
+        b = value;
+    }
+    bool flag = (compare == '>' && a > b) || (compare == '=' && a == b) || (compare == '<' && a < b);
+    if (flag) {
+        jump(program);
+    }
+    return;
+}
+StatementType CountedLoop::getType() {
+    return FUSED_STMT;
+}
+
+
+static bool isReduction(const std::string &token) {
+    return token == "SUM" || token == "MIN" || token == "MAX";
+}
+
+static Expression *parseBound(const std::string &expression) {
+    TokenScanner new_token(expression);
+    new_token.ignoreWhitespace();
+    new_token.scanNumbers();
+    return parseExp(new_token);
+}
+
+PARALLEL::PARALLEL(TokenScanner& token) {
+    line = 0;
+    token.nextToken();
+    if (token.nextToken() != "FOR") error("SYNTAX ERROR");
+    std::string name = token.nextToken();
+    if (token.getTokenType(name) != WORD || token.nextToken() != "=") error("SYNTAX ERROR");
+    variable = internSymbol(name);
+    std::string first, last, next;
+    while (token.hasMoreTokens() && (next = token.nextToken()) != "TO") {
+        first += next;
+    }
+    if (next != "TO") error("SYNTAX ERROR");
+    while (token.hasMoreTokens()) {
+        next = token.nextToken();
+        if (isReduction(next)) {
+            token.saveToken(next);
+            break;
+        }
+        last += next;
+    }
+    while (token.hasMoreTokens()) {
+        next = token.nextToken();
+        char kind = next == "SUM" ? '+' : next == "MIN" ? '<' : next == "MAX" ? '>' : 0;
+        if (kind == 0) error("SYNTAX ERROR");
+        while (true) {
+            std::string name = token.nextToken();
+            if (token.getTokenType(name) != WORD || isReduction(name)) error("SYNTAX ERROR");
+            reductions.push_back({kind, internSymbol(name)});
+            if (!token.hasMoreTokens()) break;
+            next = token.nextToken();
+            if (next != ",") {
+                token.saveToken(next);
+                break;
+            }
+        }
+    }
+    std::unique_ptr<Expression> start(parseBound(first));
+    to = parseBound(last);
+    from = start.release();
+    shareSubexpressions({&from, &to});
+}
+PARALLEL::PARALLEL(int variable, Expression* from, Expression* to,
+                   const std::vector<std::pair<char, int>>& reductions) {
+    this->variable = variable;
+    this->from = from;
+    this->to = to;
+    this->reductions = reductions;
+    line = 0;
+    shareSubexpressions({&this->from, &this->to});
+}
+PARALLEL::~PARALLEL() {
+    delete from;
+    delete to;
+    from = nullptr;
+    to = nullptr;
+}
 
+/*
+ * Implementation notes: PARALLEL::execute
+ * ---------------------------------------
+ * The pool is shared by every loop in the process.  Its tasks never
+ * wait for other tasks, since a body cannot contain another loop, so
+ * the thread that runs the loop can simply block until the last chunk
+ * is done.  Each chunk starts with the locals of the body undefined,
+ * which the body cannot notice since it assigns them before reading
+ * them, so a local that is defined when the chunk ends was assigned by
+ * it.
+ *
+ * The loop may run up to INT_MAX, so the number of iterations and the
+ * bounds of the chunks are computed in long long, and the value the
+ * variable is left with past the end, like a SUM, wraps around as the
+ * unsigned arithmetic of division by -1 does instead of overflowing.
+ */
 
+static ThreadPool &parallelPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void PARALLEL::execute(EvalState& state, Program& program) {
+    state.resetTemporaries();
+    int first = from->eval(state);
+    int last = to->eval(state);
+    if (first > last) {
+        state.setValue(variable, first);
+        jump(program);
+        return;
+    }
+    long long count = (long long) last - first + 1;
+    int chunks = (int) std::min<long long>(count, 64);
+    struct Chunk {
+        EvalState state;
+        bool failed = false;
+        std::string message;
+    };
+    std::vector<Chunk> results(chunks);
+    std::mutex lock;
+    std::condition_variable finished;
+    int remaining = chunks;
+    for (int c = 0; c < chunks; ++c) {
+        int low = (int) (first + count * c / chunks);
+        int high = (int) (first + count * (c + 1) / chunks - 1);
+        parallelPool().submit([&, c, low, high] {
+            Chunk &chunk = results[c];
+            chunk.state.copyVariables(state);
+            for (int local : locals) {
+                chunk.state.removeValue(local);
+            }
+            for (auto &reduction : reductions) {
+                int identity = reduction.first == '+' ? 0 : reduction.first == '<' ? INT_MAX : INT_MIN;
+                chunk.state.setValue(reduction.second, identity);
+            }
+            try {
+                program.run_loop_(chunk.state, variable, low, high, line, getTarget());
+            }
+            catch (ErrorException &ex) {
+                chunk.failed = true;
+                chunk.message = ex.getMessage();
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            if (--remaining == 0) finished.notify_one();
+        });
+    }
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        finished.wait(guard, [&remaining] { return remaining == 0; });
+    }
+    for (Chunk &chunk : results) {
+        if (chunk.failed) error(chunk.message);
+    }
+    std::vector<int> combined;
+    for (auto &reduction : reductions) {
+        bool defined = state.isDefined(reduction.second);
+        int value = defined ? state.getValue(reduction.second) : 0;
+        for (int c = 0; c < chunks; ++c) {
+            int part = results[c].state.getValue(reduction.second);
+            if (!defined && c == 0) value = part;
+            else if (reduction.first == '+') value = (int) ((unsigned) value + (unsigned) part);
+            else if (reduction.first == '<') value = std::min(value, part);
+            else value = std::max(value, part);
+        }
+        combined.push_back(value);
+    }
+    for (int local : locals) {
+        for (int c = chunks - 1; c >= 0; --c) {
+            if (results[c].state.isDefined(local)) {
+                state.setValue(local, results[c].state.getValue(local));
+                break;
+            }
+        }
+    }
+    for (size_t r = 0; r < reductions.size(); ++r) {
+        state.setValue(reductions[r].second, combined[r]);
+    }
+    state.setValue(variable, (int) ((unsigned) last + 1u));
+    program.count_steps_(count);
+    jump(program);
+}
+StatementType PARALLEL::getType() {
+    return PARALLEL_STMT;
+}
+std::vector<Expression **> PARALLEL::getExpressions() {
+    return {&from, &to};
+}
+void PARALLEL::validate() {
+    Statement::validate();
+    for (size_t r = 0; r < reductions.size(); ++r) {
+        if (reductions[r].second == variable) error("SYNTAX ERROR");
+        for (size_t other = 0; other < r; ++other) {
+            if (reductions[other].second == reductions[r].second) error("SYNTAX ERROR");
+        }
+    }
+}
+int PARALLEL::getVariable() {
+    return variable;
+}
+std::vector<int> PARALLEL::getAssigned() {
+    std::vector<int> assigned = {variable};
+    for (auto &reduction : reductions) {
+        assigned.push_back(reduction.second);
+    }
+    return assigned;
+}
+const std::vector<std::pair<char, int>>& PARALLEL::getReductions() {
+    return reductions;
+}
+void PARALLEL::link(int line, int next, const std::vector<int>& locals) {
+    this->line = line;
+    this->locals = locals;
+    Set(next);
+}
+const std::vector<int>& PARALLEL::getLocals() {
+    return locals;
+}
+
+NEXT::NEXT(TokenScanner& token) {
+    token.nextToken();
+    std::string name = token.nextToken();
+    if (token.getTokenType(name) != WORD || token.hasMoreTokens()) error("SYNTAX ERROR");
+    variable = internSymbol(name);
+}
+NEXT::NEXT(int variable) {
+    this->variable = variable;
+}
+void NEXT::execute(EvalState&, Program&) {
+    return;
+}
+StatementType NEXT::getType() {
+    return NEXT_STMT;
+}
+int NEXT::getVariable() {
+    return variable;
+}
 
 Sequential::Sequential(TokenScanner& token) {
+    exp = nullptr;
     std::string order = token.nextToken();
     if (order == "REM") {
         type = REM;
-        input="comment";
+        input = -1;
     }
     else if (order == "LET") {
         type = LET;
+        input = -1;
         std::string expression, next;
         while (token.hasMoreTokens()) {
             next = token.nextToken();
@@ -180,13 +525,15 @@ Sequential::Sequential(TokenScanner& token) {
         new_token.ignoreWhitespace();
         new_token.scanNumbers();
         exp = parseExp(new_token);
+        shareSubexpressions({&exp});
     }
     else if (order == "INPUT") {
         type = INPUT;
-        input = token.nextToken();
+        input = internSymbol(token.nextToken());
     }
     else if (order == "PRINT") {
         type = PRINT;
+        input = -1;
         std::string expression, next;
         while (token.hasMoreTokens()) {
             next = token.nextToken();
@@ -196,18 +543,27 @@ Sequential::Sequential(TokenScanner& token) {
         new_token.ignoreWhitespace();
         new_token.scanNumbers();
         exp = parseExp(new_token);
+        shareSubexpressions({&exp});
     }
 }
-Sequential::~Sequential() {
-    if(type!=REM && type!=INPUT ){
-        delete exp;
+Sequential::Sequential(StatementType type, Expression* exp, int variable) {
+    this->exp = exp;
+    if (type == REM_STMT) {
+        this->type = REM;
+        input = -1;
     }
-    exp = nullptr;
-}
-void Sequential::kill(){
-    if(type!=REM){
-        delete exp;
+    else if (type == INPUT_STMT) {
+        this->type = INPUT;
+        input = variable;
+    }
+    else {
+        this->type = type == LET_STMT ? LET : PRINT;
+        input = -1;
+        shareSubexpressions({&this->exp});
     }
+}
+Sequential::~Sequential() {
+    delete exp;
     exp = nullptr;
 }
 void Sequential::execute(EvalState& state, Program& program) {
@@ -216,18 +572,27 @@ void Sequential::execute(EvalState& state, Program& program) {
         break;
     }
     case LET: {
+        state.resetTemporaries();
         (*exp).eval(state);
         break;
     }
     case INPUT: {
         while(1){
-            std::cout<<' '<<'?'<<' ';
+            //挂起后恢复执行时，提示已经输出过。
+            if(!state.isInputPrompted()){
+                state.getOutput()<<' '<<'?'<<' ';
+                state.setInputPrompted(true);
+            }
             std::string in;
-            getline(std::cin,in);
+            if(!state.readInput(in)){
+                //没有可用的输入：挂起，pointer不变，恢复后重新执行本句。
+                return;
+            }
+            state.setInputPrompted(false);
             int pointer=0,flag=1;
             char check=in[0];
             if(check!='-'&&check!='+'&&(check>'9'||check<'0')){
-                std::cout<<"INVALID NUMBER"<<'\n';
+                state.getOutput()<<"INVALID NUMBER"<<'\n';
                 continue;
             }
             else{
@@ -235,7 +600,7 @@ void Sequential::execute(EvalState& state, Program& program) {
                 while(in[pointer]!=0&&flag){
                     check=in[pointer];
                     if(check>'9'||check<'0'){
-                        std::cout<<"INVALID NUMBER"<<'\n';
+                        state.getOutput()<<"INVALID NUMBER"<<'\n';
                         flag=0;
                     }
                     ++pointer;
@@ -244,7 +609,7 @@ void Sequential::execute(EvalState& state, Program& program) {
                     continue;
                 }
                 else{
-                   int in_number=0,ten=1;
+                   unsigned in_number=0,ten=1;
                    --pointer;
                    while(pointer>=0&&in[pointer]!='-'&&in[pointer]!='+'){
                     in_number+=ten*(in[pointer]-'0');
@@ -252,9 +617,9 @@ void Sequential::execute(EvalState& state, Program& program) {
                     --pointer;
                    }
                    if(in[0]=='-'){
-                    in_number=-in_number;
+                    in_number=0u-in_number;
                    }
-                   state.setValue(input, in_number);
+                   state.setValue(input, (int) in_number);
                    break;
                 }
             }
@@ -262,11 +627,28 @@ void Sequential::execute(EvalState& state, Program& program) {
         break;
     }
     case PRINT: {
+        state.resetTemporaries();
         int outcome=(*exp).eval(state);
-        std::cout << outcome << '\n';
+        state.getOutput() << outcome << '\n';
         break;
     }
     }
     return;
 }
-
+StatementType Sequential::getType() {
+    switch (type) {
+    case REM: return REM_STMT;
+    case LET: return LET_STMT;
+    case INPUT: return INPUT_STMT;
+    default: return PRINT_STMT;
+    }
+}
+std::vector<Expression **> Sequential::getExpressions() {
+    if (type == LET || type == PRINT) {
+        return {&exp};
+    }
+    return {};
+}
+int Sequential::getVariable() {
+    return input;
+}
@@ -14,6 +14,7 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
 #include "evalstate.hpp"
 #include "exp.hpp"
 #include "Utils/tokenScanner.hpp"
@@ -23,6 +24,19 @@
 #include "Utils/strlib.hpp"
 
 class Program;
+
+/*
+ * Type: StatementType
+ * -------------------
+ * This enumerated type is used to differentiate the kinds of
+ * statement, so that passes over a whole program can inspect the
+ * control flow and the assignments of each line.
+ */
+
+enum StatementType {
+    COMMAND_STMT, REM_STMT, LET_STMT, INPUT_STMT, PRINT_STMT, GOTO_STMT, IF_STMT, END_STMT, FUSED_STMT, PARALLEL_STMT, NEXT_STMT
+};
+
 /*
  * Class: Statement
  * ----------------
@@ -56,7 +70,6 @@ public:
  */
 
     virtual ~Statement();
-    virtual void kill();
 
 /*
  * Method: execute
@@ -71,6 +84,40 @@ public:
     //这些执行对EVAL与Pro起作用。
     virtual void execute(EvalState& state, Program& program) = 0;
 
+/*
+ * Method: getType
+ * Usage: StatementType type = stmt->getType();
+ * --------------------------------------------
+ * Returns the kind of the statement.
+ */
+
+    virtual StatementType getType() = 0;
+
+/*
+ * Method: getExpressions
+ * Usage: for (Expression **root : stmt->getExpressions()) . . .
+ * -------------------------------------------------------------
+ * Returns the addresses of the expression trees owned by the statement
+ * in the order in which execute evaluates them, so that a pass can
+ * inspect or replace them.  The default implementation returns none.
+ */
+
+    virtual std::vector<Expression **> getExpressions();
+
+/*
+ * Method: validate
+ * Usage: stmt->validate();
+ * ------------------------
+ * Checks the properties of the statement that do not depend on the
+ * values of variables, raising the error that executing it would
+ * otherwise report: an assignment to something other than a variable
+ * or to a variable named LET, or an IF with an unknown comparison.
+ * The default implementation checks the assignments in the expressions
+ * returned by getExpressions, so execute can assume they are valid.
+ */
+
+    virtual void validate();
+
 };
 
 
@@ -88,12 +135,13 @@ public:
 class Command :public Statement {
 private:
     enum type {
-        RUN,LIST,CLEAR
+        RUN,LIST,CLEAR,MEM,SAVEVARS,LOADVARS
     };
     type type;
 public:
     Command(TokenScanner& token);
     virtual void execute(EvalState& state, Program& program);
+    virtual StatementType getType();
 };
 
 class Control :public Statement {
@@ -103,7 +151,8 @@ public:
     Control();
     ~Control();
     void Set(int a);
-    virtual void kill();
+    //跳转目标行号，END为-1。
+    int getTarget();
     virtual void jump(Program& program);
 };
 
@@ -111,7 +160,10 @@ class GOTO :public Control {
 private:
 public:
     GOTO(TokenScanner& token);
+    //由各部分直接构造，供从程序映像载入时使用；下同。
+    explicit GOTO(int target);
     virtual void execute(EvalState& state, Program& program);
+    virtual StatementType getType();
 };
 
 class IF :public Control {
@@ -121,16 +173,133 @@ private:
     char compare;
 public:
     IF(TokenScanner& token);
+    IF(Expression* lhs, char compare, Expression* rhs, int target);
     ~IF();
-    virtual void kill();
     virtual void execute(EvalState& state, Program& program);
+    virtual StatementType getType();
+    virtual std::vector<Expression **> getExpressions();
+    virtual void validate();
+    Expression* getLHS();
+    Expression* getRHS();
+    //比较符：'<'、'='或'>'，未知的比较符为0。
+    char getCompare();
 };
 
 class END :public Control {
 private:
 public:
     END(TokenScanner& token);
+    END();
+    virtual void execute(EvalState& state, Program& program);
+    virtual StatementType getType();
+};
+
+/*
+ * Class: CountedLoop
+ * ------------------
+ * This statement is never parsed; it is built when a program is
+ * prepared for RUN and stands for the common pair of lines
+ *
+ *     L1 LET I = I + c        (or I - c, or c + I)
+ *     L2 IF I < N THEN T      (any comparison, I on either side)
+ *
+ * where T is an earlier line.  Executed at L1, it updates I, moves the
+ * program counter to L2 and performs the comparison and the branch in
+ * one dispatch, reading I once.  The bound expression belongs to the
+ * IF statement and is only borrowed.
+ */
+
+class CountedLoop :public Control {
+private:
+    int variable;
+    int step;
+    int compare_line;
+    //IF语句中界限表达式的根，不归本语句所有。
+    Expression** bound;
+    bool bound_first;
+    char compare;
+public:
+    CountedLoop(int variable, int step, int compare_line,
+                Expression** bound, bool bound_first, char compare, int target);
+    virtual void execute(EvalState& state, Program& program);
+    virtual StatementType getType();
+};
+
+/*
+ * Class: PARALLEL
+ * ---------------
+ * This statement represents the line
+ *
+ *     PARALLEL FOR I = a TO b SUM S, T MIN U MAX V
+ *
+ * whose body is every line up to the first following NEXT I.  The
+ * iterations I = a, ..., b are split into at most 64 contiguous chunks,
+ * depending only on the number of iterations, and the chunks run on a
+ * thread pool.  Each chunk works on its own copy of the variables, in
+ * which the reduction variables start at 0, the largest or the smallest
+ * integer.  Afterwards each reduction variable is combined from its
+ * value before the loop, if any, and the results of all chunks, every
+ * other variable assigned in the body has its value from the last
+ * chunk that assigned it, and I is b + 1, or a if the body never ran.
+ * An error stops the loop with the error of the earliest iteration that
+ * failed and leaves the variables unchanged.
+ *
+ * The body may not contain INPUT, PRINT, END or another PARALLEL FOR,
+ * and no jump may leave or enter it.  A variable the body assigns,
+ * other than I and the reduction variables, must be assigned on every
+ * path through an iteration before it is read, so that no iteration
+ * depends on the one before it.  These rules are checked for the whole
+ * program when it is compiled for RUN, which also links the statement
+ * to its NEXT line, the target of the jump made when the loop is done.
+ */
+
+class PARALLEL :public Control {
+private:
+    int variable;
+    Expression* from;
+    Expression* to;
+    //归约：'+'为SUM，'<'为MIN，'>'为MAX，及变量的符号。
+    std::vector<std::pair<char, int>> reductions;
+    //循环体中赋值的其他变量，每次迭代都先赋值后读取。
+    std::vector<int> locals;
+    int line;
+public:
+    PARALLEL(TokenScanner& token);
+    PARALLEL(int variable, Expression* from, Expression* to,
+             const std::vector<std::pair<char, int>>& reductions);
+    ~PARALLEL();
+    virtual void execute(EvalState& state, Program& program);
+    virtual StatementType getType();
+    virtual std::vector<Expression **> getExpressions();
+    virtual void validate();
+    //循环变量的符号。
+    int getVariable();
+    //循环结束时由本语句赋值的变量：循环变量与归约变量。
+    std::vector<int> getAssigned();
+    const std::vector<std::pair<char, int>>& getReductions();
+    //编译时设置本语句所在行、对应的NEXT行与循环体的局部变量。
+    void link(int line, int next, const std::vector<int>& locals);
+    const std::vector<int>& getLocals();
+};
+
+/*
+ * Class: NEXT
+ * -----------
+ * This statement closes the body of a PARALLEL FOR.  Executing it does
+ * nothing: the loop ends each iteration when control reaches it, and
+ * jumps to it when the loop is done.
+ */
+
+class NEXT :public Statement {
+private:
+    int variable;
+public:
+    NEXT(TokenScanner& token);
+    explicit NEXT(int variable);
     virtual void execute(EvalState& state, Program& program);
+    virtual StatementType getType();
+    //循环变量的符号。
+    int getVariable();
 };
 
 class Sequential :public Statement {
@@ -139,13 +308,20 @@ private:
         REM, LET, INPUT, PRINT
     };
     type1 type;
-    std::string input;
+    //INPUT语句读入的变量的符号，其余语句为-1。
+    int input;
+    //LET与PRINT的表达式，REM与INPUT为nullptr。
     Expression* exp;
 public:
     Sequential(TokenScanner& token);
+    //type为REM_STMT、LET_STMT、PRINT_STMT或INPUT_STMT，后者的变量的符号为variable。
+    Sequential(StatementType type, Expression* exp, int variable);
     ~Sequential();
-    virtual void kill();
     virtual void execute(EvalState& state, Program& program);
+    virtual StatementType getType();
+    virtual std::vector<Expression **> getExpressions();
+    //INPUT语句读入的变量的符号。
+    int getVariable();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,70 @@
+/*
+ * File: symbols.cpp
+ * -----------------
+ * Implements the symbols.h interface.
+ */
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include "symbols.hpp"
+#include "memory.hpp"
+
+/*
+ * Implementation notes: the table
+ * -------------------------------
+ * Lines are parsed on many threads at once by the server and the batch
+ * runner, so the table is guarded by a reader-writer lock and most
+ * lookups, which find a name that is already there, share it.  The
+ * names live in a deque, which never moves its elements as it grows,
+ * and the map is keyed by views of those same strings.
+ */
+
+namespace {
+
+struct Table {
+    std::shared_mutex lock;
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, int> symbols;
+};
+
+Table &table() {
+    static Table table;
+    return table;
+}
+
+}
+
+int internSymbol(const std::string &name) {
+    Table &t = table();
+    {
+        std::shared_lock<std::shared_mutex> guard(t.lock);
+        auto iter = t.symbols.find(name);
+        if (iter != t.symbols.end()) return (*iter).second;
+    }
+    std::unique_lock<std::shared_mutex> guard(t.lock);
+    auto iter = t.symbols.find(name);
+    if (iter != t.symbols.end()) return (*iter).second;
+    int symbol = (int) t.names.size();
+    t.names.push_back(name);
+    t.symbols.emplace(t.names.back(), symbol);
+    return symbol;
+}
+
+const std::string &getSymbolName(int symbol) {
+    Table &t = table();
+    std::shared_lock<std::shared_mutex> guard(t.lock);
+    return t.names[symbol];
+}
+
+size_t getSymbolBytes() {
+    Table &t = table();
+    std::shared_lock<std::shared_mutex> guard(t.lock);
+    size_t bytes = t.names.size() * sizeof(std::string);
+    for (const std::string &name : t.names) {
+        bytes += stringBytes(name);
+    }
+    return bytes + hashBytes(t.symbols.size(), t.symbols.bucket_count(), sizeof(std::pair<const std::string_view, int>));
+}
@@ -0,0 +1,46 @@
+/*
+ * File: symbols.h
+ * ---------------
+ * This interface exports the table of symbols, which gives every
+ * distinct identifier a small integer that stands for it everywhere
+ * else in the interpreter.
+ */
+
+#ifndef _symbols_h
+#define _symbols_h
+
+#include <string>
+
+/*
+ * Function: internSymbol
+ * Usage: int symbol = internSymbol(name);
+ * ---------------------------------------
+ * Returns the symbol for name, adding it to the table if it is new.
+ * Symbols are numbered from 0 in the order in which they are first
+ * seen, and they are never removed, so the same name has the same
+ * symbol in every program and on every thread for the life of the
+ * process.
+ */
+
+int internSymbol(const std::string &name);
+
+/*
+ * Function: getSymbolName
+ * Usage: const std::string &name = getSymbolName(symbol);
+ * -------------------------------------------------------
+ * Returns the name of a symbol returned by internSymbol.  The reference
+ * stays valid for the life of the process.
+ */
+
+const std::string &getSymbolName(int symbol);
+
+/*
+ * Function: getSymbolBytes
+ * Usage: size_t bytes = getSymbolBytes();
+ * ---------------------------------------
+ * Returns the bytes of heap memory used by the table of symbols.
+ */
+
+size_t getSymbolBytes();
+
+#endif
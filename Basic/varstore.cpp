@@ -0,0 +1,267 @@
+/*
+ * File: varstore.cpp
+ * ------------------
+ * Implements the varstore.h interface.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "varstore.hpp"
+#include "evalstate.hpp"
+#include "files.hpp"
+#include "symbols.hpp"
+#include "Utils/error.hpp"
+
+/*
+ * Implementation notes: file format
+ * ---------------------------------
+ * The header is followed by the records, each a four-byte value, the
+ * length of the name and the name, padded to a multiple of four bytes.
+ * Integers are in the byte order of the machine.  The field used of
+ * the header counts the bytes of complete records, and the records
+ * after it, if any, are ignored.
+ *
+ * An attached store writes an assignment to a variable already in the
+ * file as a single aligned store to its value.  A new variable is
+ * written past the end of the records, and only then does used grow
+ * to include it, so a process that dies at any point leaves a file
+ * that reads back as the variables before or after the assignment.
+ * Any change to the layout must change the version.
+ */
+
+namespace {
+
+const char MAGIC[8] = {'B', 'A', 'S', 'I', 'V', 'A', 'R', 'S'};
+const uint32_t VERSION = 1;
+const size_t INITIAL_SIZE = 4096;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t used;
+};
+
+struct Record {
+    int32_t value;
+    uint32_t length;
+};
+
+struct Variable {
+    std::string name;
+    int value;
+    uint64_t offset;
+};
+
+size_t recordBytes(size_t length) {
+    return (sizeof(Record) + length + 3) & ~(size_t) 3;
+}
+
+void putRecord(char *at, const std::string &name, int value) {
+    Record *record = (Record *) at;
+    record->value = value;
+    record->length = (uint32_t) name.size();
+    memcpy(at + sizeof(Record), name.data(), name.size());
+}
+
+bool readVariables(const char *base, size_t size, std::vector<Variable> &variables) {
+    if (size < sizeof(Header)) return false;
+    const Header *header = (const Header *) base;
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION
+        || header->used > size - sizeof(Header)) {
+        return false;
+    }
+    uint64_t offset = sizeof(Header);
+    uint64_t end = offset + header->used;
+    while (offset < end) {
+        if (end - offset < sizeof(Record)) return false;
+        const Record *record = (const Record *) (base + offset);
+        if (record->length == 0 || record->length > end - offset - sizeof(Record)) return false;
+        variables.push_back({std::string(base + offset + sizeof(Record), record->length), record->value, offset});
+        offset += recordBytes(record->length);
+    }
+    return offset == end;
+}
+
+}
+
+VariableStore::VariableStore(const std::string &path) : path_(path) {
+}
+
+VariableStore::~VariableStore() {
+    if (base_ != nullptr) munmap(base_, size_);
+    if (fd_ >= 0) close(fd_);
+}
+
+void VariableStore::save(const EvalState &state) {
+    if (base_ != nullptr) {
+        if (msync(base_, size_, MS_SYNC) != 0) error("CANNOT SAVE VARIABLES");
+        return;
+    }
+    std::string data(sizeof(Header), '\0');
+    Header *header = (Header *) &data[0];
+    memcpy(header->magic, MAGIC, sizeof(MAGIC));
+    header->version = VERSION;
+    for (auto &variable : state.getVariables()) {
+        const std::string &name = getSymbolName(variable.first);
+        size_t offset = data.size();
+        data.resize(offset + recordBytes(name.size()), '\0');
+        putRecord(&data[offset], name, variable.second);
+    }
+    ((Header *) &data[0])->used = data.size() - sizeof(Header);
+    if (!replaceFile(path_, data)) error("CANNOT SAVE VARIABLES");
+}
+
+void VariableStore::load(EvalState &state) {
+    if (base_ != nullptr) return;
+    std::vector<Variable> variables;
+    bool valid = false;
+    int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0) {
+        void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            valid = readVariables((const char *) mapped, info.st_size, variables);
+            munmap(mapped, info.st_size);
+        }
+    }
+    if (fd >= 0) close(fd);
+    if (!valid) error("CANNOT LOAD VARIABLES");
+    state.Clear();
+    for (Variable &variable : variables) {
+        state.setValue(variable.name, variable.value);
+    }
+}
+
+/*
+ * Implementation notes: attach
+ * ----------------------------
+ * Restoring the variables costs one pass over the records, since every
+ * name must be interned to find its symbol in this process; nothing of
+ * the session that produced them is replayed.  A new store gets its
+ * header before the file grows, so a crash while it is created leaves
+ * an empty store rather than a file that attach would refuse.
+ */
+
+bool VariableStore::attach(EvalState &state) {
+    int fd = open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) close(fd);
+        error("CANNOT OPEN VARIABLES");
+    }
+    size_t size = info.st_size;
+    std::vector<Variable> variables;
+    bool restored = false;
+    void *mapped = MAP_FAILED;
+    if (size > 0) {
+        mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        restored = mapped != MAP_FAILED && readVariables((const char *) mapped, size, variables);
+        if (!restored) {
+            if (mapped != MAP_FAILED) munmap(mapped, size);
+            close(fd);
+            error("CANNOT OPEN VARIABLES");
+        }
+    }
+    else {
+        Header header;
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.reserved = 0;
+        header.used = 0;
+        size = INITIAL_SIZE;
+        if (pwrite(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header) && ftruncate(fd, size) == 0) {
+            mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            error("CANNOT OPEN VARIABLES");
+        }
+    }
+    fd_ = fd;
+    base_ = (char *) mapped;
+    size_ = size;
+    offsets_.clear();
+    if (restored) {
+        state.Clear();
+        for (Variable &variable : variables) {
+            int symbol = internSymbol(variable.name);
+            state.setValue(symbol, variable.value);
+            offsets_[symbol] = variable.offset;
+        }
+    }
+    else {
+        rewrite(state);
+    }
+    state.setStore(this, true);
+    return restored;
+}
+
+void VariableStore::set(int symbol, int value) {
+    auto iter = offsets_.find(symbol);
+    if (iter != offsets_.end()) {
+        ((Record *) (base_ + (*iter).second))->value = value;
+        return;
+    }
+    const std::string &name = getSymbolName(symbol);
+    size_t bytes = recordBytes(name.size());
+    reserve(bytes);
+    Header *header = (Header *) base_;
+    uint64_t offset = sizeof(Header) + header->used;
+    putRecord(base_ + offset, name, value);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->used += bytes;
+    offsets_[symbol] = offset;
+}
+
+void VariableStore::clear() {
+    ((Header *) base_)->used = 0;
+    offsets_.clear();
+}
+
+/*
+ * Implementation notes: rewrite
+ * -----------------------------
+ * The new variables almost always include the old ones, as they do
+ * after a PARALLEL FOR or a precomputed run, and then the file is only
+ * updated and extended.  Otherwise it is emptied first.
+ */
+
+void VariableStore::rewrite(const EvalState &state) {
+    for (auto &variable : offsets_) {
+        if (!state.isDefined(variable.first)) {
+            clear();
+            break;
+        }
+    }
+    for (auto &variable : state.getVariables()) {
+        set(variable.first, variable.second);
+    }
+}
+
+/*
+ * Implementation notes: reserve
+ * -----------------------------
+ * The larger mapping is made before the old one is dropped, so if the
+ * file cannot grow the store goes on with the old mapping.
+ */
+
+void VariableStore::reserve(size_t bytes) {
+    size_t needed = sizeof(Header) + ((Header *) base_)->used + bytes;
+    if (needed <= size_) return;
+    size_t size = std::max(2 * size_, needed);
+    void *mapped = MAP_FAILED;
+    if (ftruncate(fd_, size) == 0) {
+        mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    }
+    if (mapped == MAP_FAILED) error("CANNOT SAVE VARIABLES");
+    munmap(base_, size_);
+    base_ = (char *) mapped;
+    size_ = size;
+}
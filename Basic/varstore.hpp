@@ -0,0 +1,137 @@
+/*
+ * File: varstore.h
+ * ----------------
+ * This interface exports the VariableStore class, which keeps the
+ * variables of an EvalState in a file, so that they outlive the
+ * process.
+ */
+
+#ifndef _varstore_h
+#define _varstore_h
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+class EvalState;
+
+/*
+ * Class: VariableStore
+ * --------------------
+ * A VariableStore saves variables to a file and loads them back, in one
+ * of two modes:
+ *
+ * - On request, save writes a snapshot of the variables of a state and
+ *   load replaces them with the snapshot.  These are the SAVEVARS and
+ *   LOADVARS commands.
+ *
+ * - Once attach has been called, the file is mapped into memory and
+ *   every change to the variables of the state is written to it as it
+ *   happens.  A process that attaches to the file later, even after the
+ *   previous one crashed, starts with the variables as they were at
+ *   the last completed assignment, without replaying anything.
+ *
+ * The file is a small header followed by a record per variable, its
+ * value and its name.  The header carries a magic number and a format
+ * version, and attach and load refuse a file with another version
+ * rather than overwrite it.
+ */
+
+class VariableStore {
+
+public:
+
+/*
+ * Constructor: VariableStore
+ * Usage: VariableStore store(path);
+ * ---------------------------------
+ * Creates a store that uses the file at path.  The file is not touched
+ * until one of the methods below is called.
+ */
+
+    explicit VariableStore(const std::string &path);
+
+/*
+ * Destructor: ~VariableStore
+ * Usage: usually implicit
+ * -----------------------
+ * Unmaps and closes the file if the store is attached.  The state must
+ * not be attached to the store any more.
+ */
+
+    ~VariableStore();
+
+    VariableStore(const VariableStore &) = delete;
+    VariableStore &operator=(const VariableStore &) = delete;
+
+/*
+ * Method: save
+ * Usage: store.save(state);
+ * -------------------------
+ * Replaces the contents of the file with the variables of state.  The
+ * new file is written beside the old one and renamed over it, so the
+ * file is never seen half written.  When the store is attached, the
+ * file already holds the variables, and save only flushes it to disk.
+ * Raises an error if the file cannot be written.
+ */
+
+    void save(const EvalState &state);
+
+/*
+ * Method: load
+ * Usage: store.load(state);
+ * -------------------------
+ * Replaces the variables of state with those saved in the file.
+ * Raises an error, leaving state unchanged, if the file is missing,
+ * damaged or of another version.  When the store is attached to state,
+ * the two already agree and nothing is done.
+ */
+
+    void load(EvalState &state);
+
+/*
+ * Method: attach
+ * Usage: bool restored = store.attach(state);
+ * -------------------------------------------
+ * Maps the file into memory, creating it if needed, and attaches the
+ * store to state.  If the file holds variables, they replace those of
+ * state and the method returns true; if it is missing or empty, it
+ * starts out with the variables of state and the method returns false.
+ * Raises an error, leaving the file as it is, if it cannot be opened
+ * or mapped or is not a store in the current format.
+ */
+
+    bool attach(EvalState &state);
+
+/*
+ * Methods: set, clear, rewrite
+ * Usage: store.set(symbol, value);
+ * --------------------------------
+ * Called by an attached EvalState to record an assignment, the removal
+ * of all variables, and the replacement of all of them by those of
+ * state.  An assignment to a variable already in the file rewrites its
+ * value in place; a new variable is appended and becomes part of the
+ * file only once its record is complete.
+ */
+
+    void set(int symbol, int value);
+
+    void clear();
+
+    void rewrite(const EvalState &state);
+
+private:
+    std::string path_;
+    int fd_ = -1;
+    char *base_ = nullptr;
+    size_t size_ = 0;
+    //符号->其记录在文件中的偏移。
+    std::unordered_map<int, uint64_t> offsets_;
+
+    //把文件扩大到至少能再容纳bytes字节的记录，并重新映射。
+    void reserve(size_t bytes);
+
+};
+
+#endif
@@ -19,6 +19,18 @@ int getCurrentThreadForPlatform();
 
 void yieldForPlatform();
 
+/* Methods for thread pools */
+
+int initPoolForPlatform(int nThreads);
+
+void freePoolForPlatform(int id);
+
+void submitForPlatform(int id, void (*fn)(void *), void *arg);
+
+void waitPoolForPlatform(int id);
+
+int poolSizeForPlatform(int id);
+
 /* Methods for locks */
 
 int initLockForPlatform();
@@ -30,8 +30,9 @@ static void forkWithVoid(void *arg);
 
 Thread fork(void (*fn)()) {
     Thread thread;
-    StartWithVoid startup = {fn};
-    thread.id = forkForPlatform(forkWithVoid, &startup);
+    StartWithVoid *startup = new StartWithVoid();
+    startup->fn = fn;
+    thread.id = forkForPlatform(forkWithVoid, startup);
     return thread;
 }
 
@@ -49,6 +50,32 @@ Thread getCurrentThread() {
     return thread;
 }
 
+ThreadPool::ThreadPool() {
+    id = initPoolForPlatform(0);
+}
+
+ThreadPool::ThreadPool(int nThreads) {
+    id = initPoolForPlatform(nThreads);
+}
+
+ThreadPool::~ThreadPool() {
+    freePoolForPlatform(id);
+}
+
+void ThreadPool::submit(void (*fn)()) {
+    StartWithVoid *startup = new StartWithVoid();
+    startup->fn = fn;
+    submitForPlatform(id, forkWithVoid, startup);
+}
+
+void ThreadPool::wait() {
+    waitPoolForPlatform(id);
+}
+
+int ThreadPool::size() {
+    return poolSizeForPlatform(id);
+}
+
 Lock::Lock() {
     id = initLockForPlatform();
 }
@@ -66,6 +93,7 @@ void Lock::signal() {
 }
 
 static void forkWithVoid(void *arg) {
-    StartWithVoid *startup = (StartWithVoid *) arg;
-    startup->fn();
+    StartWithVoid startup = *(StartWithVoid *) arg;
+    delete (StartWithVoid *) arg;
+    startup.fn();
 }
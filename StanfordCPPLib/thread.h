@@ -115,6 +115,100 @@ void yield();
 
 Thread getCurrentThread();
 
+/*
+ * Class: ThreadPool
+ * -----------------
+ * This class represents a fixed set of worker threads that run the
+ * tasks submitted to the pool, which avoids the cost of creating a
+ * thread for every small piece of work.  The standard paradigm for
+ * using a pool looks like this:
+ *
+ *<pre>
+ *    ThreadPool pool;
+ *    for (int i = 0; i < n; i++) {
+ *       pool.submit(fn, data[i]);
+ *    }
+ *    pool.wait();
+ *</pre>
+ *
+ * Tasks may themselves submit more tasks, which are kept by the worker
+ * that submitted them and taken over by idle workers.
+ */
+
+class ThreadPool {
+
+public:
+
+/*
+ * Constructor: ThreadPool
+ * Usage: ThreadPool pool;
+ *        ThreadPool pool(nThreads);
+ * ---------------------------------
+ * Starts a pool with the specified number of worker threads.  The
+ * first form starts one worker for every processor.
+ */
+
+    ThreadPool();
+    ThreadPool(int nThreads);
+
+/*
+ * Destructor: ~ThreadPool
+ * -----------------------
+ * Waits for every submitted task to finish and stops the workers.
+ */
+
+    ~ThreadPool();
+
+/*
+ * Method: submit
+ * Usage: pool.submit(fn);
+ *        pool.submit(fn, data);
+ * -----------------------------
+ * Arranges for a worker to call <code>fn</code>.  As with
+ * <code>fork</code>, the second form passes an argument to
+ * <code>fn</code>, which must remain valid until the task has run.
+ */
+
+    void submit(void (*fn)());
+
+    template<typename ClientType>
+    void submit(void (*fn)(ClientType &data), ClientType &data);
+
+/*
+ * Method: wait
+ * Usage: pool.wait();
+ * -------------------
+ * Waits until every task submitted so far, including the tasks they
+ * submit, has finished.  The calling thread runs pending tasks while
+ * it waits.  A task must not call <code>wait</code> on its own pool,
+ * since it would be waiting for itself.
+ */
+
+    void wait();
+
+/*
+ * Method: size
+ * Usage: int nThreads = pool.size();
+ * ----------------------------------
+ * Returns the number of worker threads in the pool.
+ */
+
+    int size();
+
+/**********************************************************************/
+/* Note: Everything below this point in this class is logically part  */
+/* of the implementation and should not be of interest to clients.    */
+/**********************************************************************/
+
+private:
+
+    long id;     /* id linking this pool to the platform-specific data */
+
+    ThreadPool(const ThreadPool &src) = delete;
+    ThreadPool &operator=(const ThreadPool &src) = delete;
+
+};
+
 /*
  * Class: Lock
  * -----------
@@ -241,6 +335,8 @@ private:
 
 int forkForPlatform(void (*fn)(void *), void *dp);
 
+void submitForPlatform(int id, void (*fn)(void *), void *dp);
+
 struct StartWithVoid {
     void (*fn)();
 };
@@ -252,19 +348,37 @@ struct StartWithClientData {
     ClientType *dp;
 };
 
+/*
+ * The startup record is allocated on the heap and freed by the new
+ * thread, since the caller may return before the thread reads it.
+ */
+
 template<typename ClientType>
 static void forkWithClientData(void *arg) {
-    StartWithClientData<ClientType> *startup =
-            (StartWithClientData<ClientType> *) arg;
-    startup->fn(*startup->dp);
+    StartWithClientData<ClientType> startup =
+            *(StartWithClientData<ClientType> *) arg;
+    delete (StartWithClientData<ClientType> *) arg;
+    startup.fn(*startup.dp);
 }
 
 template<typename ClientType>
 Thread fork(void (*fn)(ClientType &data), ClientType &data) {
-    StartWithClientData<ClientType> startup = {fn, &data};
+    StartWithClientData<ClientType> *startup =
+            new StartWithClientData<ClientType>();
+    startup->fn = fn;
+    startup->dp = &data;
     Thread thread;
-    thread.id = forkForPlatform(forkWithClientData<ClientType>, &startup);
+    thread.id = forkForPlatform(forkWithClientData<ClientType>, startup);
     return thread;
 }
 
+template<typename ClientType>
+void ThreadPool::submit(void (*fn)(ClientType &data), ClientType &data) {
+    StartWithClientData<ClientType> *startup =
+            new StartWithClientData<ClientType>();
+    startup->fn = fn;
+    startup->dp = &data;
+    submitForPlatform(id, forkWithClientData<ClientType>, startup);
+}
+
 #endif
@@ -0,0 +1,572 @@
+/*
+ * File: tplatform.cpp
+ * -------------------
+ * This file implements the tplatform.h interface for Linux, using
+ * std::thread for threads and futexes for locks and idle workers.
+ */
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "private/tplatform.h"
+
+using namespace std;
+
+/*
+ * Implementation notes: futexes
+ * -----------------------------
+ * A futex waits in the kernel only while the word it names still holds
+ * the value the caller last saw, so a wakeup that happens between
+ * reading the word and going to sleep is never lost.
+ */
+
+static void futexWait(atomic<int> *word, int value) {
+    syscall(SYS_futex, (int *) word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void futexWake(atomic<int> *word, int count) {
+    syscall(SYS_futex, (int *) word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+/*
+ * Class: Registry
+ * ---------------
+ * Maps the integer ids of the interface to platform data.  Entries
+ * live in chunks that are never moved, so that looking up an id needs
+ * no lock; adding and removing entries are serialized by a mutex, and
+ * the ids of removed entries are reused.
+ */
+
+template <typename ValueType>
+class Registry {
+
+public:
+
+    Registry() {
+        for (int i = 0; i < CHUNKS; i++) {
+            chunks[i].store(NULL);
+        }
+    }
+
+    int add(ValueType *value) {
+        lock_guard<mutex> guard(lock);
+        int id;
+        if (!unused.empty()) {
+            id = unused.back();
+            unused.pop_back();
+        } else {
+            id = next++;
+            if (id >= CHUNKS * CHUNK_SIZE) abort();
+            if ((id % CHUNK_SIZE) == 0) {
+                chunks[id / CHUNK_SIZE].store(new atomic<ValueType *>[CHUNK_SIZE]);
+            }
+        }
+        chunks[id / CHUNK_SIZE].load()[id % CHUNK_SIZE].store(value);
+        return id;
+    }
+
+    ValueType *get(int id) {
+        if (id < 0 || id >= CHUNKS * CHUNK_SIZE) return NULL;
+        atomic<ValueType *> *chunk = chunks[id / CHUNK_SIZE].load(memory_order_acquire);
+        if (chunk == NULL) return NULL;
+        return chunk[id % CHUNK_SIZE].load(memory_order_acquire);
+    }
+
+    ValueType *remove(int id) {
+        lock_guard<mutex> guard(lock);
+        ValueType *value = get(id);
+        if (value != NULL) {
+            chunks[id / CHUNK_SIZE].load()[id % CHUNK_SIZE].store(NULL);
+            unused.push_back(id);
+        }
+        return value;
+    }
+
+private:
+
+    static const int CHUNKS = 1024;
+    static const int CHUNK_SIZE = 1024;
+
+    atomic<atomic<ValueType *> *> chunks[CHUNKS];
+    mutex lock;
+    vector<int> unused;
+    int next = 0;
+
+};
+
+/*
+ * The registries are allocated once and never freed, so that threads
+ * still running when the program exits cannot outlive them.
+ */
+
+struct ThreadData {
+    thread handle;
+    int refCount = 0;
+    bool joining = false;
+    bool finished = false;
+};
+
+struct ThreadTable {
+    Registry<ThreadData> registry;
+    mutex lock;
+    condition_variable joined;
+};
+
+static ThreadTable &threads() {
+    static ThreadTable *table = new ThreadTable();
+    return *table;
+}
+
+static thread_local int currentThreadId = -1;
+
+struct ThreadStart {
+    void (*fn)(void *);
+    void *arg;
+    int id;
+};
+
+static void startThread(ThreadStart start) {
+    currentThreadId = start.id;
+    start.fn(start.arg);
+}
+
+int forkForPlatform(void (*fn)(void *), void *arg) {
+    ThreadTable &table = threads();
+    ThreadData *data = new ThreadData();
+    lock_guard<mutex> guard(table.lock);
+    int id = table.registry.add(data);
+    ThreadStart start = { fn, arg, id };
+    data->handle = thread(startThread, start);
+    return id;
+}
+
+void incThreadRefCountForPlatform(int id) {
+    ThreadTable &table = threads();
+    lock_guard<mutex> guard(table.lock);
+    ThreadData *data = table.registry.get(id);
+    if (data != NULL) data->refCount++;
+}
+
+void decThreadRefCountForPlatform(int id) {
+    ThreadTable &table = threads();
+    lock_guard<mutex> guard(table.lock);
+    ThreadData *data = table.registry.get(id);
+    if (data != NULL && --data->refCount <= 0 && data->finished) {
+        delete table.registry.remove(id);
+    }
+}
+
+/*
+ * Implementation notes: joinForPlatform
+ * -------------------------------------
+ * Only the first caller joins the std::thread; any other thread that
+ * joins the same thread waits until that join is complete.  A thread
+ * that has been joined and is not referenced is forgotten, and joining
+ * an id that is no longer known returns immediately.
+ */
+
+void joinForPlatform(int id) {
+    ThreadTable &table = threads();
+    unique_lock<mutex> guard(table.lock);
+    ThreadData *data = table.registry.get(id);
+    if (data == NULL) return;
+    if (data->joining) {
+        while (!data->finished) {
+            table.joined.wait(guard);
+        }
+        return;
+    }
+    data->joining = true;
+    thread handle;
+    handle.swap(data->handle);
+    guard.unlock();
+    if (handle.joinable()) handle.join();
+    guard.lock();
+    data->finished = true;
+    table.joined.notify_all();
+    if (data->refCount <= 0) {
+        delete table.registry.remove(id);
+    }
+}
+
+int getCurrentThreadForPlatform() {
+    if (currentThreadId == -1) {
+        ThreadTable &table = threads();
+        ThreadData *data = new ThreadData();
+        lock_guard<mutex> guard(table.lock);
+        data->joining = true;
+        currentThreadId = table.registry.add(data);
+    }
+    return currentThreadId;
+}
+
+void yieldForPlatform() {
+    this_thread::yield();
+}
+
+/*
+ * Implementation notes: thread pools
+ * ----------------------------------
+ * Every worker owns a Chase-Lev deque: the worker pushes and takes
+ * tasks at the bottom without contention, and other threads steal from
+ * the top with a compare-and-swap.  Tasks submitted from outside the
+ * pool go to a bounded lock-free queue shared by all workers, in which
+ * each cell carries a sequence number telling producers and consumers
+ * whose turn it is.  A worker looks for work in its own deque, then in
+ * the shared queue, then in the deques of the other workers.
+ *
+ * An idle worker sleeps on a futex holding a counter that every submit
+ * increments.  It reads the counter before its last search for work,
+ * so a task submitted after that search wakes it or keeps it from
+ * sleeping.  The number of unfinished tasks is also a futex, on which
+ * wait sleeps until it reaches zero.
+ */
+
+struct Task {
+    void (*fn)(void *);
+    void *arg;
+};
+
+class TaskDeque {
+
+public:
+
+    TaskDeque() : top(0), bottom(0) {
+        for (int i = 0; i < CAPACITY; i++) {
+            tasks[i].store(NULL, memory_order_relaxed);
+        }
+    }
+
+    bool push(Task *task) {
+        long b = bottom.load();
+        long t = top.load();
+        if (b - t >= CAPACITY) return false;
+        tasks[b & (CAPACITY - 1)].store(task, memory_order_relaxed);
+        bottom.store(b + 1);
+        return true;
+    }
+
+    Task *take() {
+        long b = bottom.load() - 1;
+        bottom.store(b);
+        long t = top.load();
+        if (t > b) {
+            bottom.store(b + 1);
+            return NULL;
+        }
+        Task *task = tasks[b & (CAPACITY - 1)].load(memory_order_relaxed);
+        if (t == b) {
+            if (!top.compare_exchange_strong(t, t + 1)) task = NULL;
+            bottom.store(b + 1);
+        }
+        return task;
+    }
+
+    Task *steal() {
+        while (true) {
+            long t = top.load();
+            long b = bottom.load();
+            if (t >= b) return NULL;
+            Task *task = tasks[t & (CAPACITY - 1)].load(memory_order_relaxed);
+            if (top.compare_exchange_strong(t, t + 1)) return task;
+        }
+    }
+
+private:
+
+    static const int CAPACITY = 1024;
+
+    atomic<long> top;
+    atomic<long> bottom;
+    atomic<Task *> tasks[CAPACITY];
+
+};
+
+class TaskQueue {
+
+public:
+
+    TaskQueue() : head(0), tail(0) {
+        for (int i = 0; i < CAPACITY; i++) {
+            cells[i].sequence.store(i, memory_order_relaxed);
+        }
+    }
+
+    bool push(Task *task) {
+        size_t pos = tail.load(memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[pos & (CAPACITY - 1)];
+            size_t sequence = cell.sequence.load(memory_order_acquire);
+            long diff = (long) sequence - (long) pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    cell.task = task;
+                    cell.sequence.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    Task *pop() {
+        size_t pos = head.load(memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[pos & (CAPACITY - 1)];
+            size_t sequence = cell.sequence.load(memory_order_acquire);
+            long diff = (long) sequence - (long) (pos + 1);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    Task *task = cell.task;
+                    cell.sequence.store(pos + CAPACITY, memory_order_release);
+                    return task;
+                }
+            } else if (diff < 0) {
+                return NULL;
+            } else {
+                pos = head.load(memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+
+    static const int CAPACITY = 4096;
+
+    struct Cell {
+        atomic<size_t> sequence;
+        Task *task;
+    };
+
+    Cell cells[CAPACITY];
+    atomic<size_t> head;
+    atomic<size_t> tail;
+
+};
+
+struct PoolData {
+    vector<TaskDeque *> deques;
+    vector<thread> workers;
+    TaskQueue queue;
+    atomic<int> epoch;
+    atomic<int> sleepers;
+    atomic<int> pending;
+    atomic<bool> stopping;
+};
+
+static Registry<PoolData> &pools() {
+    static Registry<PoolData> *registry = new Registry<PoolData>();
+    return *registry;
+}
+
+static thread_local PoolData *currentPool = NULL;
+static thread_local int currentWorker = -1;
+
+static Task *findTask(PoolData *pool, int self) {
+    Task *task = NULL;
+    if (self >= 0) task = pool->deques[self]->take();
+    if (task == NULL) task = pool->queue.pop();
+    int n = pool->deques.size();
+    for (int i = 1; task == NULL && i <= n; i++) {
+        int victim = (self + i + n) % n;
+        if (victim != self) task = pool->deques[victim]->steal();
+    }
+    return task;
+}
+
+static void runTask(PoolData *pool, Task *task) {
+    task->fn(task->arg);
+    delete task;
+    if (pool->pending.fetch_sub(1) == 1) {
+        futexWake(&pool->pending, INT_MAX);
+    }
+}
+
+static void runWorker(PoolData *pool, int self) {
+    currentPool = pool;
+    currentWorker = self;
+    while (true) {
+        Task *task = findTask(pool, self);
+        if (task != NULL) {
+            runTask(pool, task);
+            continue;
+        }
+        int epoch = pool->epoch.load();
+        task = findTask(pool, self);
+        if (task != NULL) {
+            runTask(pool, task);
+            continue;
+        }
+        if (pool->stopping.load()) break;
+        pool->sleepers.fetch_add(1);
+        futexWait(&pool->epoch, epoch);
+        pool->sleepers.fetch_sub(1);
+    }
+}
+
+int initPoolForPlatform(int nThreads) {
+    if (nThreads <= 0) nThreads = thread::hardware_concurrency();
+    if (nThreads <= 0) nThreads = 1;
+    PoolData *pool = new PoolData();
+    pool->epoch.store(0);
+    pool->sleepers.store(0);
+    pool->pending.store(0);
+    pool->stopping.store(false);
+    for (int i = 0; i < nThreads; i++) {
+        pool->deques.push_back(new TaskDeque());
+    }
+    for (int i = 0; i < nThreads; i++) {
+        pool->workers.push_back(thread(runWorker, pool, i));
+    }
+    return pools().add(pool);
+}
+
+void freePoolForPlatform(int id) {
+    PoolData *pool = pools().get(id);
+    if (pool == NULL) return;
+    waitPoolForPlatform(id);
+    pools().remove(id);
+    pool->stopping.store(true);
+    pool->epoch.fetch_add(1);
+    futexWake(&pool->epoch, INT_MAX);
+    for (size_t i = 0; i < pool->workers.size(); i++) {
+        pool->workers[i].join();
+    }
+    for (size_t i = 0; i < pool->deques.size(); i++) {
+        delete pool->deques[i];
+    }
+    delete pool;
+}
+
+/*
+ * Implementation notes: submitForPlatform
+ * ---------------------------------------
+ * A worker keeps the tasks it submits in its own deque.  When a deque
+ * or the shared queue is full, the submitting thread runs queued tasks
+ * itself until there is room, which also bounds the memory a runaway
+ * producer can use.
+ */
+
+void submitForPlatform(int id, void (*fn)(void *), void *arg) {
+    PoolData *pool = pools().get(id);
+    if (pool == NULL) return;
+    Task *task = new Task();
+    task->fn = fn;
+    task->arg = arg;
+    pool->pending.fetch_add(1);
+    bool queued = currentPool == pool && pool->deques[currentWorker]->push(task);
+    while (!queued && !pool->queue.push(task)) {
+        Task *other = findTask(pool, currentPool == pool ? currentWorker : -1);
+        if (other != NULL) {
+            runTask(pool, other);
+        } else {
+            this_thread::yield();
+        }
+    }
+    pool->epoch.fetch_add(1);
+    if (pool->sleepers.load() > 0) futexWake(&pool->epoch, 1);
+}
+
+void waitPoolForPlatform(int id) {
+    PoolData *pool = pools().get(id);
+    if (pool == NULL) return;
+    int self = currentPool == pool ? currentWorker : -1;
+    while (true) {
+        int pending = pool->pending.load();
+        if (pending == 0) return;
+        Task *task = findTask(pool, self);
+        if (task != NULL) {
+            runTask(pool, task);
+        } else {
+            futexWait(&pool->pending, pending);
+        }
+    }
+}
+
+int poolSizeForPlatform(int id) {
+    PoolData *pool = pools().get(id);
+    return pool == NULL ? 0 : pool->workers.size();
+}
+
+/*
+ * Implementation notes: locks
+ * ---------------------------
+ * The lock word is 0 when the lock is free, 1 when it is held and 2
+ * when it is held and other threads may be sleeping on it, so unlock
+ * makes a system call only in the last case.  wait and signal use a
+ * second word that signal increments: wait reads it before releasing
+ * the lock and sleeps only if no signal has happened since.
+ */
+
+struct LockData {
+    atomic<int> state;
+    atomic<int> sequence;
+    atomic<int> refCount;
+};
+
+static Registry<LockData> &locks() {
+    static Registry<LockData> *registry = new Registry<LockData>();
+    return *registry;
+}
+
+int initLockForPlatform() {
+    LockData *data = new LockData();
+    data->state.store(0);
+    data->sequence.store(0);
+    data->refCount.store(1);
+    return locks().add(data);
+}
+
+void incLockRefCountForPlatform(int id) {
+    LockData *data = locks().get(id);
+    if (data != NULL) data->refCount.fetch_add(1);
+}
+
+void decLockRefCountForPlatform(int id) {
+    LockData *data = locks().get(id);
+    if (data != NULL && data->refCount.fetch_sub(1) == 1) {
+        delete locks().remove(id);
+    }
+}
+
+void lockForPlatform(int id) {
+    LockData *data = locks().get(id);
+    int state = 0;
+    if (data->state.compare_exchange_strong(state, 1)) return;
+    if (state != 2) state = data->state.exchange(2);
+    while (state != 0) {
+        futexWait(&data->state, 2);
+        state = data->state.exchange(2);
+    }
+}
+
+void unlockForPlatform(int id) {
+    LockData *data = locks().get(id);
+    if (data->state.fetch_sub(1) != 1) {
+        data->state.store(0);
+        futexWake(&data->state, 1);
+    }
+}
+
+void waitForPlatform(int id) {
+    LockData *data = locks().get(id);
+    int sequence = data->sequence.load();
+    unlockForPlatform(id);
+    futexWait(&data->sequence, sequence);
+    lockForPlatform(id);
+}
+
+void signalForPlatform(int id) {
+    LockData *data = locks().get(id);
+    data->sequence.fetch_add(1);
+    futexWake(&data->sequence, INT_MAX);
+}
@@ -0,0 +1,11 @@
+# Runs the programs in data/batch with --batch, merged on two workers
+# and then on one worker with each output in its own .out file.
+
+echo "== merged"
+"$CODE" --batch batch --merged --workers 2 2> /dev/null
+echo "== separate"
+"$CODE" --batch batch --workers 1 2> /dev/null
+for name in batch/*.bas; do
+    echo "-- ${name%.bas}.out"
+    cat "${name%.bas}.out"
+done
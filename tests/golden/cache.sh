@@ -0,0 +1,46 @@
+# Runs the programs in data/batch through an image cache that is first
+# empty, then warm, then damaged in several ways, and then the program
+# in data/lanes through a cache of its own.  A damaged image must be
+# ignored, so every run prints the same.
+
+merged() {
+    "$CODE" --batch batch --merged --workers 2 --cache cache 2> /dev/null
+}
+
+mkdir cache
+echo "== cold cache"
+merged
+echo "== images: $(ls cache/*.img | wc -l)"
+echo "== warm cache"
+merged
+
+# Each image moves to the name of the next one, as if two sources had
+# the same hash.
+images=(cache/*.img)
+cp "${images[0]}" first.img
+for ((i = 0; i + 1 < ${#images[@]}; i++)); do
+    cp "${images[i + 1]}" "${images[i]}"
+done
+mv first.img "${images[-1]}"
+echo "== swapped images"
+merged
+
+for image in cache/*.img; do
+    truncate -s 40 "$image"
+done
+echo "== truncated images"
+merged
+
+for image in cache/*.img; do
+    printf 'BASIMAGE%s' "$(head -c 200 /dev/zero | tr '\0' 'x')" > "$image"
+done
+echo "== garbage images"
+merged
+
+mkdir lanes-cache
+echo "== lanes, cold and warm"
+for i in 1 2; do
+    "$CODE" --lanes lanes/prog.bas --width 8 --cache lanes-cache < lanes/prog.rec > lanes.txt
+    cmp -s lanes.txt <("$CODE" --lanes lanes/prog.bas --width 8 < lanes/prog.rec) && echo same || echo different
+done
+echo "== lanes images: $(ls lanes-cache/*.img | wc -l)"
@@ -0,0 +1,7 @@
+10 INPUT X
+20 INPUT Y
+30 PRINT X * Y
+40 LET N = 0
+50 LET N = N + X
+60 IF N < 100 THEN 50
+70 PRINT N
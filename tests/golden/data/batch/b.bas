@@ -0,0 +1,3 @@
+10 LET A = 5
+20 PRINT A / (A - 5)
+30 PRINT 1
@@ -0,0 +1,4 @@
+10 REM no input file, so INPUT hits the end
+20 PRINT 3
+30 INPUT Z
+40 PRINT Z
@@ -0,0 +1,7 @@
+10 LET S = 0
+20 PARALLEL FOR I = 1 TO 10 SUM S
+30 LET S = S + I * I
+40 NEXT I
+50 PRINT S
+60 GOTO 80
+70 PRINT 0
@@ -0,0 +1,12 @@
+10 INPUT A
+20 INPUT B
+30 LET C = 0
+40 IF A > B THEN 80
+50 LET C = C + A
+60 LET A = A + 1
+70 IF A < B THEN 50
+80 PRINT C
+90 IF C = 0 THEN 120
+100 PRINT 1000 / (C - 10)
+110 END
+120 PRINT A * B - C
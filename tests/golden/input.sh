@@ -0,0 +1,56 @@
+# Server sessions parked on INPUT: answers that arrive later in pieces,
+# an answer that is not a number, an INPUT typed as a command, and a
+# session that hangs up while parked, on a single worker so that every
+# parked session must give it back.
+
+command -v python3 > /dev/null || exit 77
+
+for quantum in 0 5; do
+    "$CODE" --server "$PWD/s.sock" --workers 1 --quantum $quantum 2> /dev/null &
+    server=$!
+    for i in $(seq 100); do
+        [ -S s.sock ] && break
+        sleep 0.1
+    done
+    python3 - "$PWD/s.sock" <<'PY'
+import socket, sys, time
+
+def connect():
+    s = socket.socket(socket.AF_UNIX)
+    s.connect(sys.argv[1])
+    s.settimeout(30)
+    return s
+
+def read(s):
+    out = b''
+    while True:
+        data = s.recv(4096)
+        if not data:
+            return out.decode()
+        out += data
+
+gone = connect()
+gone.sendall(b"10 INPUT G\nRUN\n")
+first = connect()
+second = connect()
+first.sendall(b"10 INPUT A\n20 INPUT B\n30 PRINT A - B\nRUN\n")
+second.sendall(b"INPUT X\n")
+time.sleep(0.2)
+gone.close()
+first.sendall(b"4")
+second.sendall(b"seven\n")
+time.sleep(0.2)
+first.sendall(b"0\n1")
+second.sendall(b"7\nPRINT X * X\n")
+time.sleep(0.2)
+first.sendall(b"2\nRUN\n-1\n-1\nQUIT\n")
+second.sendall(b"QUIT\n")
+print("first:")
+print(read(first), end="")
+print("second:")
+print(read(second), end="")
+PY
+    kill $server
+    wait $server 2> /dev/null
+    rm -f s.sock
+done
@@ -0,0 +1,46 @@
+# Rebuilds a program from its --journal across processes: after edits,
+# after CLEAR, after the last record was torn or followed by garbage,
+# and after enough edits of one line to compact the file, both while
+# editing and when the next process attaches.  A file that
+# is not a journal is refused.
+
+code() {
+    printf '%s\n' "$@" QUIT | "$CODE" --journal edits.log 2>&1
+}
+
+echo "== edits"
+code "10 LET A = 1" "20 LET B = 2" "30 PRINT 0" "40 PRINT A + B" "20 LET B = 20" 30 LIST
+code LIST RUN "50 PRINT A * B"
+code RUN
+
+echo "== clear"
+code CLEAR "10 PRINT 7"
+code LIST
+
+echo "== torn tail"
+code "20 PRINT 8" "30 PRINT 9"
+truncate -s -3 edits.log
+code LIST "40 PRINT 10"
+code LIST
+
+echo "== garbage tail"
+head -c 64 /dev/zero | tr '\0' 'z' >> edits.log
+code LIST "20"
+code RUN
+
+echo "== compaction"
+for i in $(seq 3000); do
+    echo "10 PRINT $i"
+done > lines.txt
+echo QUIT >> lines.txt
+"$CODE" --journal edits.log < lines.txt
+size=$(wc -c < edits.log)
+[ $size -lt 81920 ] && echo "compacted while editing" || echo "$size bytes after editing"
+code LIST
+size=$(wc -c < edits.log)
+[ $size -lt 4096 ] && echo "compacted when attached" || echo "$size bytes after attaching"
+
+echo "== refused"
+echo "not a journal" > other.log
+printf 'PRINT 1\nQUIT\n' | "$CODE" --journal other.log 2>&1
+echo "status $?"
@@ -0,0 +1,11 @@
+# Runs data/lanes/prog.bas over the records in prog.rec, 8 and 16 at a
+# time, then one record at a time under a statement limit.  The records
+# branch apart and meet again, fail in some lanes only, and include a
+# word that is not a number and records that run out of input.
+
+for width in 8 16; do
+    echo "== width $width"
+    "$CODE" --lanes lanes/prog.bas --width $width < lanes/prog.rec
+done
+echo "== max-statements 40"
+"$CODE" --lanes lanes/prog.bas --max-statements 40 < lanes/prog.rec
@@ -0,0 +1,27 @@
+# Runs the same program under each of the limits, just below and at the
+# amount the program needs, then a loop that never ends under a time
+# limit.  A run is checked when it jumps back and when it ends.
+
+cat > limits.bas <<'LINES'
+10 LET N = 0
+20 LET N = N + 1
+30 PRINT N * 111
+40 IF N < 5 THEN 20
+50 LET A = 1
+60 LET B = 2
+70 LET C = 3
+80 PRINT A + B + C
+RUN
+PRINT N
+QUIT
+LINES
+
+for flags in "--max-statements 10" "--max-statements 19" "--max-statements 20" \
+             "--max-variables 3" "--max-variables 4" \
+             "--max-output 20" "--max-output 21" "--max-output 22"; do
+    echo "== $flags"
+    "$CODE" $flags < limits.bas
+done
+
+echo "== --max-time 100"
+printf '10 LET X = X + 1\n20 GOTO 10\nLET X = 0\nRUN\nPRINT 1\nQUIT\n' | "$CODE" --max-time 100
@@ -0,0 +1,18 @@
+10 LET S = 0
+20 PARALLEL FOR I = 1 TO 100 SUM S
+30 LET S = S + I
+40 NEXT I
+50 LET K = 0
+60 LET K = K + 1
+70 IF K < 40 THEN 60
+80 PRINT S + K
+90 INPUT A
+100 PRINT 10 / A
+110 END
+120 PRINT 1
+RUN
+4
+RUN
+0
+PRINT K
+QUIT
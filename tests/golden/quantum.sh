@@ -0,0 +1,35 @@
+# Runs the lines of quantum.bas at the console and then in a server
+# session whose runs are sliced every 3 statements and every statement,
+# so a PARALLEL FOR, an INPUT, an error and END are each resumed in the
+# middle of a run.  The three outputs must be the same.
+
+command -v python3 > /dev/null || exit 77
+lines=$(dirname "$0")/quantum.bas
+
+"$CODE" < "$lines"
+for quantum in 3 1; do
+    "$CODE" --server "$PWD/s.sock" --workers 1 --quantum $quantum 2> /dev/null &
+    server=$!
+    for i in $(seq 100); do
+        [ -S s.sock ] && break
+        sleep 0.1
+    done
+    python3 - "$PWD/s.sock" "$lines" <<'PY'
+import socket, sys
+
+s = socket.socket(socket.AF_UNIX)
+s.connect(sys.argv[1])
+s.settimeout(30)
+s.sendall(open(sys.argv[2], 'rb').read())
+out = b''
+while True:
+    data = s.recv(4096)
+    if not data:
+        break
+    out += data
+print(out.decode(), end="")
+PY
+    kill $server
+    wait $server 2> /dev/null
+    rm -f s.sock
+done
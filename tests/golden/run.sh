@@ -0,0 +1,35 @@
+#!/bin/bash
+#
+# Runs one case of the golden-output suite and compares its standard
+# output with the expected one.
+#
+# Usage: run.sh CODE CASE
+#
+#   CASE.in    lines typed at the console, ending with QUIT; the flags
+#              in CASE.args, if that file exists, are passed to CODE
+#   CASE.sh    instead, a script for cases with several steps, run with
+#              CODE in the environment
+#   CASE.out   the expected standard output
+#
+# Each case runs in a fresh directory holding a copy of data/.  A script
+# exits with 77 to skip a case whose tools are missing.
+
+set -u
+code=$1
+name=$2
+dir=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+[ -d "$dir/data" ] && cp -R "$dir/data/." "$work/"
+cd "$work" || exit 1
+
+if [ -f "$dir/$name.sh" ]; then
+    CODE=$code bash "$dir/$name.sh" > "$work/actual.txt"
+    status=$?
+    [ $status -eq 77 ] && exit 77
+else
+    args=()
+    [ -f "$dir/$name.args" ] && read -r -a args < "$dir/$name.args"
+    "$code" "${args[@]}" < "$dir/$name.in" > "$work/actual.txt"
+fi
+diff -u "$dir/$name.out" "$work/actual.txt"
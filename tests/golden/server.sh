@@ -0,0 +1,53 @@
+# Serves two sessions at once, first on a plain pool and then with time
+# slicing, while a third session runs a loop that never ends.  Each
+# session answers its own INPUT and ends with QUIT; only the output of
+# the two that finish is compared.
+
+command -v python3 > /dev/null || exit 77
+
+serve() {
+    "$CODE" --server "$PWD/s.sock" --workers 2 "$@" 2> /dev/null &
+    server=$!
+    for i in $(seq 100); do
+        [ -S s.sock ] && break
+        sleep 0.1
+    done
+    python3 - "$PWD/s.sock" <<'PY'
+import socket, sys
+
+def connect():
+    s = socket.socket(socket.AF_UNIX)
+    s.connect(sys.argv[1])
+    s.settimeout(30)
+    return s
+
+def read(s):
+    out = b''
+    while True:
+        data = s.recv(4096)
+        if not data:
+            return out.decode()
+        out += data
+
+endless = connect()
+endless.sendall(b"10 LET X = 0\n20 LET X = X + 1\n30 GOTO 20\nRUN\n")
+first = connect()
+second = connect()
+first.sendall(b"10 LET N = 0\n20 LET N = N + 1\n30 IF N < 50000 THEN 20\n"
+              b"40 INPUT A\n50 PRINT N + A\nRUN\n7\nPRINT N\nQUIT\n")
+second.sendall(b"10 INPUT Q\n20 LET T = 0\n30 LET I = 1\n40 LET T = T + Q * I\n"
+               b"50 LET I = I + 1\n60 IF I < 4 THEN 40\n70 PRINT T\nRUN\n5\nRUN\n-1\n"
+               b"LET Q = Q + 1\nPRINT Q\nQUIT\n")
+print("first:")
+print(read(first), end="")
+print("second:")
+print(read(second), end="")
+endless.close()
+PY
+    kill $server
+    wait $server 2> /dev/null
+    rm -f s.sock
+}
+
+serve
+serve --quantum 1000
@@ -0,0 +1,15 @@
+# Runs every case given as lines at the console again with
+# --share-expressions, which must not change its output.  A new case
+# of that kind must be added to share.out as well.
+
+dir=$(dirname "$0")
+for input in "$dir"/*.in; do
+    name=$(basename "$input" .in)
+    args=()
+    [ -f "$dir/$name.args" ] && read -r -a args < "$dir/$name.args"
+    if "$CODE" --share-expressions "${args[@]}" < "$input" | cmp -s - "$dir/$name.out"; then
+        echo "$name: same"
+    else
+        echo "$name: different"
+    fi
+done
@@ -0,0 +1,45 @@
+# Five sessions run loops that never end on a single worker while a
+# sixth runs a long loop to the end: with --quantum the runs take turns,
+# so the sixth finishes, and every run logs its processor time when it
+# finishes or when its session hangs up.
+
+command -v python3 > /dev/null || exit 77
+
+"$CODE" --server "$PWD/s.sock" --workers 1 --quantum 200 2> usage.txt &
+server=$!
+for i in $(seq 100); do
+    [ -S s.sock ] && break
+    sleep 0.1
+done
+python3 - "$PWD/s.sock" <<'PY'
+import socket, sys
+
+def connect():
+    s = socket.socket(socket.AF_UNIX)
+    s.connect(sys.argv[1])
+    s.settimeout(30)
+    return s
+
+endless = [connect() for i in range(5)]
+for s in endless:
+    s.sendall(b"10 LET X = 0\n20 LET X = X + 1\n30 GOTO 20\nRUN\n")
+s = connect()
+s.sendall(b"10 LET N = 0\n20 LET N = N + 1\n30 IF N < 20000 THEN 20\n40 PRINT N\nRUN\nQUIT\n")
+out = b''
+while True:
+    data = s.recv(4096)
+    if not data:
+        break
+    out += data
+print(out.decode(), end="")
+for s in endless:
+    s.close()
+PY
+for i in $(seq 100); do
+    [ "$(wc -l < usage.txt)" -ge 6 ] && break
+    sleep 0.1
+done
+kill $server
+wait $server 2> /dev/null
+sed -E 's/^run [0-9]+ of session [0-9]+ ([a-z]+): [0-9.e+-]+ ms cpu in ([0-9]+) slices$/\1 \2/' usage.txt |
+awk '{ print $1, ($2 > 1 ? "in several slices" : "in " $2 " slice") }' | sort | uniq -c | awk '{ $1 = $1; print }'
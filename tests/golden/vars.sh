@@ -0,0 +1,45 @@
+# Saves and loads variables with --vars, keeps them across processes
+# with --autosave, including one killed in the middle of a loop, and
+# checks that a missing or foreign file is refused.
+
+code() {
+    printf '%s\n' "$@" QUIT | "$CODE" "${flags[@]}" 2>&1
+}
+
+echo "== snapshot"
+flags=(--vars snap.dat)
+code "LET A = 5" "LET B = -7" SAVEVARS "LET A = 6" "LET C = 1" LOADVARS "PRINT A" "PRINT B" "PRINT C"
+code LOADVARS "PRINT A + B"
+code "PRINT A" SAVEVARS
+code LOADVARS "PRINT A"
+
+echo "== refused"
+flags=(--vars missing/snap.dat)
+code "LET A = 1" LOADVARS "PRINT A" SAVEVARS
+echo "not a variable file" > foreign.dat
+flags=(--vars foreign.dat)
+code "LET A = 1" LOADVARS "PRINT A"
+flags=(--vars foreign.dat --autosave)
+code "PRINT 1"
+echo "status $?"
+flags=()
+code SAVEVARS LOADVARS
+
+echo "== autosave"
+flags=(--vars live.dat --autosave)
+code "LET A = 3" "10 LET B = A * 4" RUN "PRINT B"
+code "PRINT A + B" "LET A = 0 - 1" CLEAR
+code "PRINT A" "PRINT B"
+
+echo "== killed"
+mkfifo lines
+"$CODE" "${flags[@]}" < lines &
+running=$!
+exec 3> lines
+printf '%s\n' "LET X = 0" "LET Z = 0" "LET Y = 42" "10 LET X = X + 1" "20 LET Z = X" "30 GOTO 10" RUN >&3
+sleep 1
+kill -KILL $running
+wait $running 2> /dev/null
+exec 3>&-
+code "PRINT Y" "10 IF X - Z > 1 THEN 60" "20 IF X - Z < 0 THEN 60" "30 IF X < 100 THEN 60" \
+     "40 PRINT 1" "50 END" "60 PRINT 0" RUN
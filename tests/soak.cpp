@@ -0,0 +1,119 @@
+/*
+ * File: soak.cpp
+ * --------------
+ * Drives a Program through processLine for a long session of edits,
+ * RUNs and CLEARs, and fails if the resident set keeps growing once the
+ * caches have warmed up.  Each cycle also replays the lines that used
+ * to leak: an IF without THEN, an INPUT line that is replaced and
+ * removed, and statements whose constructors raise an error.
+ *
+ * Usage: soak [cycles [slackKB]]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include "../Basic/interpreter.hpp"
+#include "../Basic/program.hpp"
+#include "../Basic/evalstate.hpp"
+#include "../Basic/Utils/error.hpp"
+
+namespace {
+
+const long DEFAULT_CYCLES = 1000000;
+const long DEFAULT_SLACK_KB = 1024;
+const long CHECKS = 20;
+
+long residentKB() {
+    long size = 0, resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm == nullptr) return -1;
+    if (fscanf(statm, "%ld %ld", &size, &resident) != 2) resident = -1;
+    fclose(statm);
+    return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/*
+ * Errors are the expected outcome of some of the lines, so they are
+ * counted rather than reported.
+ */
+
+long errors = 0;
+
+void feed(const std::string &line, Program &program, EvalState &state) {
+    try {
+        processLine(line, program, state);
+    } catch (ErrorException &ex) {
+        errors++;
+    }
+}
+
+/*
+ * One cycle edits a loop whose bound and variable names change with
+ * the cycle, so the program, its compiled versions and the symbol
+ * table all see new contents within a bounded set of names.
+ */
+
+void cycle(long i, Program &program, EvalState &state, std::istringstream &input) {
+    std::string n = std::to_string(i % 97);
+    std::string v = "V" + std::to_string(i % 500);
+    feed("10 LET " + v + " = " + n, program, state);
+    feed("20 LET B = 0", program, state);
+    feed("30 LET B = B + 1", program, state);
+    feed("40 IF B < " + std::to_string(i % 7 + 1) + " THEN 30", program, state);
+    feed("50 PRINT " + v + " + B", program, state);
+    feed("60 INPUT C", program, state);
+    feed("70 PRINT C * 2", program, state);
+    feed("80 IF " + v + " < 3", program, state);
+    feed("90 LET = (" + n, program, state);
+    feed("100 IF B = 1 THEN", program, state);
+    feed("110 PARALLEL FOR I = 1 TO 3 SUM", program, state);
+    feed("120 PRINT (" + v + " + ", program, state);
+    input.clear();
+    input.str(n + "\n");
+    feed("RUN", program, state);
+    feed("60 INPUT D", program, state);
+    feed("60", program, state);
+    feed("PRINT B", program, state);
+    feed("RUN", program, state);
+    if (i % 8 == 7) feed("CLEAR", program, state);
+    if (i % 64 == 63) feed("LET " + v + " = " + n, program, state);
+}
+
+}
+
+int main(int argc, char **argv) {
+    long cycles = argc > 1 ? atol(argv[1]) : DEFAULT_CYCLES;
+    long slack = argc > 2 ? atol(argv[2]) : DEFAULT_SLACK_KB;
+    if (cycles < CHECKS) cycles = CHECKS;
+    Program program;
+    program.setPrecomputeBudget(1000);
+    EvalState state;
+    std::ostringstream output;
+    std::istringstream input;
+    state.setOutput(output);
+    state.setInput(input);
+    long warm = -1, peak = 0;
+    for (long i = 0; i < cycles; i++) {
+        cycle(i, program, state, input);
+        output.str("");
+        if ((i + 1) % (cycles / CHECKS) != 0) continue;
+        long rss = residentKB();
+        if (warm < 0) {
+            warm = rss;
+            continue;
+        }
+        if (rss > peak) peak = rss;
+        if (rss > warm + slack) {
+            std::cerr << "soak: resident set grew from " << warm << " KB to " << rss
+                      << " KB after " << i + 1 << " cycles" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "soak: " << cycles << " cycles, " << errors << " errors, resident set "
+              << warm << " KB after warm-up, " << peak << " KB at most" << std::endl;
+    return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * File: threadpool.cpp
+ * --------------------
+ * Exercises the ThreadPool of StanfordCPPLib/thread.h: tasks submitted
+ * from outside the pool, tasks that submit more tasks, the form of
+ * submit that passes data, and the stealing of tasks queued by one
+ * worker by the others.  Exits with a nonzero status on failure.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "../StanfordCPPLib/thread.h"
+
+using namespace std;
+
+namespace {
+
+const int TASKS = 20000;
+const int CHILDREN = 256;
+
+atomic<int> counted(0);
+atomic<long> summed(0);
+
+ThreadPool *pool;
+thread::id parent;
+atomic<int> children(0);
+atomic<int> stolen(0);
+atomic<bool> parentWaited(false);
+
+bool check(bool condition, const char *what) {
+    if (!condition) cerr << "threadpool: " << what << endl;
+    return condition;
+}
+
+void count() {
+    counted++;
+}
+
+void add(long &value) {
+    summed += value;
+}
+
+void child() {
+    if (this_thread::get_id() != parent) stolen++;
+    children++;
+}
+
+/*
+ * The parent queues its children in its own deque and then spins
+ * without returning to its worker, so only the other workers can run
+ * them, which they do by stealing.
+ */
+
+void spawn() {
+    parent = this_thread::get_id();
+    for (int i = 0; i < CHILDREN; i++) {
+        pool->submit(child);
+    }
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(30);
+    while (stolen.load() == 0 && chrono::steady_clock::now() < deadline) {
+        this_thread::yield();
+    }
+    parentWaited = stolen.load() > 0;
+}
+
+}
+
+int main() {
+    bool ok = true;
+    ThreadPool workers(4);
+    pool = &workers;
+    ok &= check(workers.size() == 4, "size is not the number of workers");
+
+    for (int i = 0; i < TASKS; i++) {
+        workers.submit(count);
+    }
+    workers.wait();
+    ok &= check(counted.load() == TASKS, "wait returned before every task ran");
+
+    static long values[1000];
+    long expected = 0;
+    for (int i = 0; i < 1000; i++) {
+        values[i] = i;
+        expected += i;
+        workers.submit(add, values[i]);
+    }
+    workers.wait();
+    ok &= check(summed.load() == expected, "tasks with data did not all run");
+
+    workers.submit(spawn);
+    workers.wait();
+    ok &= check(children.load() == CHILDREN, "queued children did not all run");
+    ok &= check(parentWaited.load(), "no worker stole a queued task");
+
+    workers.submit(count);
+    workers.wait();
+    ok &= check(counted.load() == TASKS + 1, "the pool stopped after stealing");
+    return ok ? 0 : 1;
+}